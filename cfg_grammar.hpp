@@ -0,0 +1,134 @@
+#ifndef CFG_GRAMMAR_H
+#define CFG_GRAMMAR_H
+
+#include "cfg_string_generator.hpp"
+
+#include <array>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	// grammar with nonterminal names longer than a char. A right hand side is a list of symbols: the ones with
+	// rules are nonterminals and the others are terminal text. compile() gives each nonterminal a char that isn't
+	// on any terminal (the start symbol gets 'S', where the generation starts), so the compiled rules are given to
+	// cfg_string_generator as usual, that gives the chars dense ids (see detail::CompiledRules). The forms being
+	// derived have a char per symbol, so there can be as many nonterminals as chars that aren't on a terminal.
+	// The generated strings are just terminal text, render() gives the names back on sentential forms and
+	// substitutions, like the ones on the derivations
+	template <template <bool low_mem> typename TypeDefs = TypeDefs>
+	class NamedGrammar {
+	public:
+		using rules_type = typename TypeDefs<false>::auto_t::rules_type;
+		using string_type = typename TypeDefs<false>::string_type;
+
+		explicit NamedGrammar(string_type start) : start(std::move(start)) {}
+
+		void add_rule(const string_type& name, std::vector<string_type> symbols)
+		{
+			rules[name].push_back(std::move(symbols));
+		}
+
+		// throws std::invalid_argument if the start symbol has no rules or 'S' is on a terminal,
+		// and std::length_error if there aren't enough free chars for the nonterminals
+		rules_type compile()
+		{
+			if (rules.count(start) == 0)
+				throw std::invalid_argument("NamedGrammar: the start symbol has no rules");
+			std::array<bool, 256> used{};
+			// '\0' isn't given to a nonterminal, the forms stay printable as C strings
+			used[0] = true;
+			for (auto& rule: rules) {
+				for (auto& symbols: rule.second) {
+					for (auto& symbol: symbols) {
+						if (rules.count(symbol) != 0)
+							continue;
+						for (char c: symbol) {
+							used[index(c)] = true;
+						}
+					}
+				}
+			}
+			if (used[index('S')])
+				throw std::invalid_argument("NamedGrammar: 'S' is on a terminal, it's reserved for the start symbol");
+
+			codes.clear();
+			names.fill(string_type());
+			assign(start, 'S');
+			used[index('S')] = true;
+			// readable chars first
+			std::vector<char> candidates;
+			for (char c = 'A'; c <= 'Z'; c++) {
+				candidates.push_back(c);
+			}
+			for (char c = 'a'; c <= 'z'; c++) {
+				candidates.push_back(c);
+			}
+			for (int c = 1; c < 256; c++) {
+				candidates.push_back(static_cast<char>(c));
+			}
+			auto candidate = candidates.begin();
+			for (auto& rule: rules) {
+				if (rule.first == start)
+					continue;
+				while (candidate != candidates.end() && used[index(*candidate)])
+					candidate++;
+				if (candidate == candidates.end())
+					throw std::length_error("NamedGrammar: more nonterminals than free chars");
+				used[index(*candidate)] = true;
+				assign(rule.first, *candidate);
+			}
+
+			rules_type compiled;
+			for (auto& rule: rules) {
+				auto& substitutions = compiled[codes.at(rule.first)];
+				for (auto& symbols: rule.second) {
+					string_type substitution;
+					for (auto& symbol: symbols) {
+						auto it = codes.find(symbol);
+						if (it != codes.end())
+							substitution.push_back(it->second);
+						else
+							substitution += symbol;
+					}
+					substitutions.push_back(std::move(substitution));
+				}
+			}
+			return compiled;
+		}
+
+		// the char given to a nonterminal by compile()
+		char code(const string_type& name) const { return codes.at(name); }
+
+		// str with each nonterminal char replaced by its name, between < and >
+		string_type render(const string_type& str) const
+		{
+			string_type rendered;
+			for (char c: str) {
+				if (names[index(c)].empty())
+					rendered.push_back(c);
+				else
+					rendered += "<" + names[index(c)] + ">";
+			}
+			return rendered;
+		}
+
+	private:
+		static std::size_t index(char c) { return static_cast<unsigned char>(c); }
+
+		void assign(const string_type& name, char c)
+		{
+			codes[name] = c;
+			names[index(c)] = name;
+		}
+
+		string_type start;
+		// sorted, so the chars given don't change between runs
+		std::map<string_type, std::vector<std::vector<string_type>>> rules;
+		std::map<string_type, char> codes;
+		std::array<string_type, 256> names;
+	};
+}
+#endif // CFG_GRAMMAR_H
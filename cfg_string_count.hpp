@@ -0,0 +1,73 @@
+#ifndef CFG_STRING_COUNT_H
+#define CFG_STRING_COUNT_H
+
+#include "cfg_string_generator.hpp"
+#include "derivation_counter.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	// widest integer available for the counts
+#ifdef __SIZEOF_INT128__
+	__extension__ typedef unsigned __int128 count_type;
+#else
+	using count_type = std::uintmax_t;
+#endif
+
+	// how many strings cfg_string_generator would generate, without generating them
+	// each derivation counts once, so these are the sizes of the repetition mode outputs, which is also
+	// the number of derivations on the derivation mode outputs. Without repetition, ambiguous grammars
+	// generate less strings than this (it's exact for unambiguous grammars)
+	template <typename Count>
+	struct StringCount {
+		Count total = 0;
+		// by_depth[d]: strings that need exactly d derivations
+		std::vector<Count> by_depth;
+		// by_length[l]: strings with l characters
+		std::vector<Count> by_length;
+		// a count didn't fit in Count, the saturated counts are the maximum of Count
+		bool overflow = false;
+	};
+
+	// decimal representation, std::to_string doesn't take 128 bit integers
+	template <typename Count>
+	std::string count_to_string(Count count)
+	{
+		std::string str;
+		do {
+			str.insert(str.begin(), static_cast<char>('0' + static_cast<int>(count % 10)));
+			count /= 10;
+		} while (count != 0);
+		return str;
+	}
+
+	// counts the strings generated from "S" with at most depth derivations, in milliseconds instead of generating them
+	template <typename Count = count_type, template <bool low_mem> typename TypeDefs = TypeDefs>
+	StringCount<Count> cfg_string_count(const typename TypeDefs<false>::auto_t::rules_type& rules, typename TypeDefs<false>::size_type depth)
+	{
+		using Types = TypeDefs<false>;
+		StringCount<Count> count;
+		count.by_depth.assign(depth + 1, 0);
+		detail::DerivationCounter<Count, Types> counter(rules, depth);
+		count.by_length.assign(counter.get_max_length() + 1, 0);
+		if (!counter.has_trees('S'))
+			return count;
+		for (typename Types::size_type n = 1; n <= depth; n++) {
+			for (typename Types::size_type l = 0; l <= counter.get_max_length(); l++) {
+				Count c = counter.at('S', n, l);
+				counter.add(count.by_depth[n], c);
+				counter.add(count.by_length[l], c);
+				counter.add(count.total, c);
+			}
+		}
+		// drop the lengths that can't be generated
+		while (count.by_length.size() > 1 && count.by_length.back() == 0)
+			count.by_length.pop_back();
+		count.overflow = counter.overflowed();
+		return count;
+	}
+}
+#endif // CFG_STRING_COUNT_H
@@ -1,769 +1,2290 @@
 ﻿#ifndef CFG_STRING_GENERATOR_H
 #define CFG_STRING_GENERATOR_H
 
-#include "barrier.hpp"
+#include "spin_barrier.hpp"
+#include "work_stealing_deque.hpp"
+#include "worker_pool.hpp"
+#include "derivation_counter.hpp"
+#include "derivation_node.hpp"
+#include "sentential_form.hpp"
+#include "fingerprint_set.hpp"
+#include "external_memory.hpp"
+#include "form_arena.hpp"
+#include "rope.hpp"
+#include "yield_cache.hpp"
+#include "run_stats.hpp"
 #include "BlockingCollection/BlockingCollection.h"
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <list>
 #include <unordered_set>
 #include <unordered_map>
 
-#define NUM_OF_THREADS 8
-
 namespace cfg_string_gen
 {
+	// length of the generated strings, besides the depth. A string being derived is dropped as soon as
+	// its nonterminals can't become a string of an allowed length (or can't finish within the depth)
+	struct LengthBound {
+		static const std::size_t none = std::numeric_limits<std::size_t>::max();
+		// the longest string generated
+		std::size_t length = none;
+		// if true, just the strings with exactly length characters are generated
+		bool exact = false;
+	};
+
+	// keeps the dual containers' levels and the done strings on disk, on sorted runs, so the memory used doesn't
+	// grow with the depth: the strings in memory take about budget bytes (the process, a few times that).
+	// The returned container still has every string, stream them to a sink to keep it flat.
+	// Just for strings (fast without derivation). budget 0 turns it off
+	struct ExternalMemory {
+		std::size_t budget = 0;
+		// where the runs are written, on a new directory removed at the end
+		std::filesystem::path directory = std::filesystem::temp_directory_path();
+	};
+
+	// builds the strings by concatenating the cached yields of each nonterminal with each number of derivation steps
+	// (see detail::YieldCache), instead of deriving each string. The cache takes up to cache_budget bytes, the least
+	// recently used yields are dropped when it's full and built again when they're needed (counted on
+	// RunStats::cache_rebuilds), one bigger than cache_budget is kept until another is cached.
+	// Just for strings (fast without derivation). cache_budget 0 turns it off
+	struct Memoization {
+		std::size_t cache_budget = 0;
+	};
+
 	namespace detail {
-		// controlled queue algorithm's worker thread
-		template <bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		void worker_cq(code_machina::BlockingCollection<T, QueueContainer>& queue,
-						Barrier& go,
-						Barrier& wait,
-						const bool& exit,
-						const typename Types::string_type& nonterminals,
-						const typename Types::auto_t::rules_type& rules,
-						code_machina::BlockingCollection<T>& done_queue)
+		// the rules, compiled once before generating. Each nonterminal gets a dense id, on a table from each char
+		// (terminal for the others), and the substitutions are laid out one after another on one buffer, with a view
+		// of each on a flat table where a nonterminal's rules are a range, so finding and expanding the nonterminals
+		// is array indexing instead of hashing.
+		// Also has the Cost of each symbol and substitution, to drop the strings that can't be finished
+		template <typename Types>
+		class CompiledRules {
+		public:
+			using rules_type = typename Types::auto_t::rules_type;
+			using string_type = typename Types::string_type;
+			using size_type = typename Types::size_type;
+			using cost_type = Cost<size_type>;
+			using substitution_type = Substitution<size_type>;
+			static constexpr size_type terminal = std::numeric_limits<size_type>::max();
+
+			// a nonterminal's rules, a range of the substitutions table
+			class Substitutions {
+			public:
+				using iterator = const substitution_type*;
+				using reverse_iterator = std::reverse_iterator<iterator>;
+
+				Substitutions(iterator first, iterator last) : first(first), last(last) {}
+				iterator begin() const { return first; }
+				iterator end() const { return last; }
+				reverse_iterator rbegin() const { return reverse_iterator(last); }
+				reverse_iterator rend() const { return reverse_iterator(first); }
+				size_type size() const { return static_cast<size_type>(last - first); }
+				const substitution_type& operator[](size_type i) const { return first[i]; }
+
+			private:
+				iterator first;
+				iterator last;
+			};
+
+			explicit CompiledRules(const rules_type& rules, LengthBound bound = {}) : rules(&rules), bound(bound)
+			{
+				ids.fill(terminal);
+				std::size_t length = 0;
+				for (auto& rule: rules) {
+					ids[index(rule.first)] = static_cast<size_type>(firsts.size());
+					firsts.push_back(static_cast<size_type>(sources.size()));
+					for (auto& substitution: rule.second) {
+						sources.push_back(&substitution);
+						length += substitution.size();
+					}
+				}
+				firsts.push_back(static_cast<size_type>(sources.size()));
+				// the views are taken once the buffer is whole, it isn't moved after
+				symbols.reserve(length);
+				for (auto source: sources) {
+					symbols += *source;
+				}
+				substitutions.reserve(sources.size());
+				std::size_t offset = 0;
+				for (size_type id = 0; id + 1 < firsts.size(); id++) {
+					for (size_type rule = firsts[id]; rule < firsts[id + 1]; rule++) {
+						std::string_view str(symbols.data() + offset, sources[rule]->size());
+						substitutions.push_back({str, rule, rule - firsts[id]});
+						offset += str.size();
+					}
+				}
+
+				// a terminal is itself, a nonterminal starts unreachable and gets cheaper
+				// as its substitutions get a cost, until nothing changes
+				for (std::size_t i = 0; i < costs.size(); i++) {
+					costs[i] = ids[i] == terminal ? cost_type{0, 1} : cost_type{cost_type::unreachable, cost_type::unreachable};
+				}
+				rule_costs.resize(substitutions.size());
+				bool changed = true;
+				while (changed) {
+					changed = false;
+					for (auto& rule: rules) {
+						cost_type& cost = costs[index(rule.first)];
+						for (auto& substitution: at(rule.first)) {
+							cost_type& rule_cost = rule_costs[substitution.rule];
+							rule_cost = cost_of(substitution.str);
+							if (rule_cost.steps == cost_type::unreachable)
+								continue;
+							// the steps and the length may come from different substitutions, both are lower bounds
+							if (rule_cost.steps + 1 < cost.steps) {
+								cost.steps = rule_cost.steps + 1;
+								changed = true;
+							}
+							if (rule_cost.length < cost.length) {
+								cost.length = rule_cost.length;
+								changed = true;
+							}
+						}
+					}
+				}
+			}
+			// the views point into symbols
+			CompiledRules(const CompiledRules&) = delete;
+			CompiledRules& operator=(const CompiledRules&) = delete;
+
+			bool is_nonterminal(char c) const { return ids[index(c)] != terminal; }
+			// the dense id of a nonterminal, terminal for the other chars
+			size_type id_of(char c) const { return ids[index(c)]; }
+			// the number of nonterminals
+			size_type size() const { return static_cast<size_type>(firsts.size() - 1); }
+			Substitutions at(char c) const
+			{
+				size_type id = ids[index(c)];
+				return {substitutions.data() + firsts[id], substitutions.data() + firsts[id + 1]};
+			}
+			// the rules' substitution substitution was compiled from, the one the derivations point to
+			const string_type& source_of(const substitution_type& substitution) const { return *sources[substitution.rule]; }
+			const rules_type& source() const { return *rules; }
+			const LengthBound& length_bound() const { return bound; }
+
+			const cost_type& cost_of(char c) const { return costs[index(c)]; }
+			const cost_type& cost_of(const substitution_type& substitution) const { return rule_costs[substitution.rule]; }
+			template <typename String>
+			cost_type cost_of(const String& str) const
+			{
+				cost_type cost;
+				for (auto c: str) {
+					cost += cost_of(c);
+				}
+				return cost;
+			}
+			// if a string with this cost can become a string within steps derivations and the length bound
+			bool fits(const cost_type& cost, size_type steps) const
+			{
+				if (cost.steps > steps || cost.length > bound.length)
+					return false;
+				// a done string has its own length
+				return !bound.exact || cost.steps != 0 || cost.length == bound.length;
+			}
+
+		private:
+			static std::size_t index(char c) { return static_cast<unsigned char>(c); }
+
+			const rules_type* rules;
+			LengthBound bound;
+			std::array<size_type, 256> ids;
+			// the first rule of each id, and one past the last rule
+			std::vector<size_type> firsts;
+			std::string symbols;
+			std::vector<substitution_type> substitutions;
+			std::vector<const string_type*> sources;
+			std::array<cost_type, 256> costs;
+			std::vector<cost_type> rule_costs;
+		};
+
+		// Types::functions::derivate, counting the bytes allocated for the derived form on the stats
+		template <bool low_mem, typename Types, typename String>
+		auto derivate(const String& s, typename Types::size_type pos, const typename Types::substitution_type& substitution,
+						const CompiledRules<Types>& rules, typename Types::node_arena& arena)
 		{
-			while (!queue.is_completed()) {
-				T s; 
-				auto status = queue.take(s);
-				if (status != code_machina::BlockingCollectionStatus::Ok) {
-					continue;
+			if constexpr(collects_stats_v<Types>) {
+				std::size_t allocated = 0;
+				auto derived = Types::functions::template derivate<low_mem>(s, pos, substitution, rules, arena, &allocated);
+				Stats<Types>::allocated(allocated);
+				return derived;
+			}
+			else {
+				return Types::functions::template derivate<low_mem>(s, pos, substitution, rules, arena);
+			}
+		}
+
+		// container-like adapter that hands the done strings to a callback instead of storing them,
+		// so they're never materialized. The callback is called from the worker threads.
+		// With dedup, the strings already handed over are remembered (just the strings, not the derivations)
+		// so each one is handed over once. They're split between stripes by hash, each with its own lock
+		template <typename T, typename Sink, bool dedup, typename Types>
+		class SinkContainer {
+		public:
+			using iterator = T*;
+
+			explicit SinkContainer(Sink& sink) :
+				sink(&sink),
+				seen(std::make_shared<std::array<Seen, stripes>>()) {}
+
+			iterator end() { return nullptr; }
+			iterator find(const typename Types::string_type&) { return nullptr; }
+			typename Types::size_type size() const { return 0; }
+			void reserve(typename Types::size_type) {}
+			void clear() {}
+
+			void insert(iterator, T&& s)
+			{
+				if constexpr(dedup) {
+					const typename Types::string_type& str = Types::functions::string_of(s);
+					Seen& stripe = (*seen)[std::hash<typename Types::string_type>()(str) % stripes];
+					std::lock_guard<std::mutex> lock(stripe.mutex);
+					if (!stripe.strings.insert(str).second) {
+						Stats<Types>::duplicates(1);
+						return;
+					}
 				}
-				// found a null, all strings of this depth were proccessed
-				else if (Types::functions::size(s) > 0 && Types::functions::at(s, 0) == '\0') {
-					// tell main thread that we are finished
-					wait.Wait();
-					// wait until main thread tells us to go
-					go.Wait();
-					if (exit) break;
-					continue;
+				insert_new(std::move(s));
+			}
+			void insert(iterator it, const T& s) { insert(it, T(s)); }
+			// hands over a string that wasn't handed over before, without remembering it
+			void insert_new(T&& s) { (*sink)(std::move(s)); }
+
+		private:
+			static const std::size_t stripes = 64;
+			struct Seen {
+				std::mutex mutex;
+				typename Types::template seen_container<typename Types::string_type> strings;
+			};
+			Sink* sink;
+			std::shared_ptr<std::array<Seen, stripes>> seen;
+		};
+
+		// a thread's own container for done strings, given to merge_done at the end.
+		// Sinks are shared between threads, since they don't store anything
+		template <typename Container>
+		Container new_done_slot(const Container&)
+		{
+			return Container();
+		}
+
+		template <typename T, typename Sink, bool dedup, typename Types>
+		SinkContainer<T, Sink, dedup, Types> new_done_slot(const SinkContainer<T, Sink, dedup, Types>& done_strings)
+		{
+			return done_strings;
+		}
+
+		// inserts a done string known not to be on the container
+		template <typename Container, typename T>
+		void insert_new(Container& done_strings, T&& s)
+		{
+			done_strings.insert(done_strings.end(), std::forward<T>(s));
+		}
+
+		template <typename T, typename Sink, bool dedup, typename Types>
+		void insert_new(SinkContainer<T, Sink, dedup, Types>& done_strings, T&& s)
+		{
+			done_strings.insert_new(std::move(s));
+		}
+
+		// inserts a done string, counting it on the stats if the container drops it
+		template <typename Types, typename Container, typename T>
+		void insert_counted(Container& done_strings, T&& s)
+		{
+			if constexpr(collects_stats_v<Types>) {
+				auto before = done_strings.size();
+				done_strings.insert(done_strings.end(), std::forward<T>(s));
+				if (done_strings.size() == before)
+					Stats<Types>::duplicates(1);
+			}
+			else {
+				done_strings.insert(done_strings.end(), std::forward<T>(s));
+			}
+		}
+
+		// sinks count the ones they drop
+		template <typename Types, typename T, typename Sink, bool dedup, typename S>
+		void insert_counted(SinkContainer<T, Sink, dedup, Types>& done_strings, S&& s)
+		{
+			done_strings.insert(done_strings.end(), std::forward<S>(s));
+		}
+
+		// inserts a done string on the container. If merge_derivations is true and the
+		// string is already there, its derivations are added to the existing ones
+		template <bool merge_derivations, typename Types, typename Container, typename T>
+		void insert_done(Container& done_strings, T&& s)
+		{
+			auto done = Types::functions::materialize(std::forward<T>(s));
+			if constexpr(merge_derivations) {
+				auto it = done_strings.find(done.first);
+				if (it != done_strings.end()) {
+					Stats<Types>::duplicates(1);
+					Types::functions::merge(done.second, it->second);
+					return;
 				}
-				OutContainer new_strings;
-		
-				// find the first nonterminal
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
-				if (pos == Types::string_type::npos) {  // no nonterminal found, string done
-					done_queue.add(std::move(s));
-					continue;
+			}
+			insert_counted<Types>(done_strings, std::move(done));
+		}
+
+		// merges the forms a thread derived into a level
+		template <bool merge_derivations, typename Types, typename Container>
+		void merge_forms(Container& src, Container& dest)
+		{
+			if constexpr(merge_derivations) {
+				// the strings dest doesn't have are moved over, the ones left on src are on dest already
+				dest.merge(src);
+				for (auto& s: src) {
+					Types::functions::merge(s.second, dest.find(s.first)->second);
 				}
-				// do all derivations possible
-				for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
-					new_strings.insert(new_strings.end(), Types::functions::template derivate<low_mem>(s, pos, substitution));
+				src.clear();
+			}
+			else {
+				Types::functions::merge(src, dest);
+			}
+		}
+
+		// merges the done strings of a thread into the final container, counting the ones dest had already
+		template <bool merge_derivations, typename Types, typename Container>
+		void merge_done(Container& src, Container& dest)
+		{
+			std::size_t before = dest.size() + src.size();
+			merge_forms<merge_derivations, Types>(src, dest);
+			Stats<Types>::duplicates(before - dest.size());
+		}
+
+		// the strings were handed over already
+		template <bool merge_derivations, typename Types, typename T, typename Sink, bool dedup>
+		void merge_done(SinkContainer<T, Sink, dedup, Types>&, SinkContainer<T, Sink, dedup, Types>&) {}
+
+		// inserts a form on a level of the dual containers. If merge_derivations is true and the form is
+		// already there, its derivations are added to the existing ones, otherwise the first one is kept
+		template <bool merge_derivations, typename Types, typename Container, typename T>
+		void insert_form(Container& forms, T&& s)
+		{
+			if constexpr(merge_derivations) {
+				auto it = forms.find(s.first);
+				if (it != forms.end()) {
+					Types::functions::merge(s.second, it->second);
+					return;
 				}
-				typename Types::size_type added;
-				queue.add_bulk(std::make_move_iterator(new_strings.begin()), std::make_move_iterator(new_strings.end()), added);
 			}
+			forms.insert(forms.end(), std::forward<T>(s));
 		}
-		
-		// inserts done strings on the OutContainer safely
-		template <typename T, typename Container>
-		void done_guard(code_machina::BlockingCollection<T>& done_queue, Container& done_strings)
+
+		// the done strings of the threads that share one container. The strings are split between stripes
+		// by hash, each a container with its own lock, so threads just wait for each other on the same stripe.
+		// The stripes hold different strings, so merging them into the final container doesn't merge derivations
+		template <bool merge_derivations, typename Container, typename Types>
+		class StripedContainer {
+		public:
+			StripedContainer(Container&, typename Types::size_type num_of_threads) : stripes(num_of_threads * stripes_per_thread) {}
+
+			template <typename T>
+			void insert(T&& s)
+			{
+				auto done = Types::functions::materialize(std::forward<T>(s));
+				auto hash = std::hash<typename Types::string_type>()(Types::functions::string_of(done));
+				Stripe& stripe = stripes[hash % stripes.size()];
+				std::lock_guard<std::mutex> lock(stripe.mutex);
+				insert_done<merge_derivations, Types>(stripe.strings, std::move(done));
+			}
+			// inserts and clears batch, locking each stripe once
+			template <typename T>
+			void insert_bulk(std::vector<T>& batch)
+			{
+				using Done = decltype(Types::functions::materialize(std::declval<T>()));
+				std::vector<std::pair<std::size_t, Done>> done;
+				done.reserve(batch.size());
+				for (auto& s: batch) {
+					auto str = Types::functions::materialize(std::move(s));
+					auto hash = std::hash<typename Types::string_type>()(Types::functions::string_of(str));
+					done.emplace_back(hash % stripes.size(), std::move(str));
+				}
+				batch.clear();
+				std::sort(done.begin(), done.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+				for (auto first = done.begin(); first != done.end();) {
+					Stripe& stripe = stripes[first->first];
+					std::lock_guard<std::mutex> lock(stripe.mutex);
+					for (auto index = first->first; first != done.end() && first->first == index; first++) {
+						insert_done<merge_derivations, Types>(stripe.strings, std::move(first->second));
+					}
+				}
+			}
+
+			void merge_into(Container& dest)
+			{
+				for (auto& stripe: stripes) {
+					merge_done<false, Types>(stripe.strings, dest);
+				}
+			}
+
+		private:
+			static const typename Types::size_type stripes_per_thread = 8;
+			struct Stripe {
+				std::mutex mutex;
+				Container strings;
+			};
+			std::vector<Stripe> stripes;
+		};
+
+		// sinks are thread safe already
+		template <bool merge_derivations, typename T, typename Sink, bool dedup, typename Types>
+		class StripedContainer<merge_derivations, SinkContainer<T, Sink, dedup, Types>, Types> {
+		public:
+			using Container = SinkContainer<T, Sink, dedup, Types>;
+
+			StripedContainer(Container& done_strings, typename Types::size_type) : done_strings(done_strings) {}
+
+			template <typename S>
+			void insert(S&& s) { done_strings.insert(done_strings.end(), Types::functions::materialize(std::forward<S>(s))); }
+			template <typename S>
+			void insert_bulk(std::vector<S>& batch)
+			{
+				for (auto& s: batch) {
+					insert(std::move(s));
+				}
+				batch.clear();
+			}
+			void merge_into(Container&) {}
+
+		private:
+			Container done_strings;
+		};
+
+		// how many strings a queue worker moves at once. A level (or the queue) is split in about batches_per_thread
+		// batches per thread, so the threads share the end of it, and a batch has at most max strings
+		struct QueueBatch {
+			static constexpr std::size_t max = 256;
+			static constexpr std::size_t batches_per_thread = 8;
+
+			static std::size_t of(std::size_t strings, std::size_t num_of_threads)
+			{
+				return std::clamp<std::size_t>(strings / (num_of_threads * batches_per_thread), 1, max);
+			}
+		};
+
+		// controlled queue algorithm's worker thread
+		// the strings of a level are on its queue, the ones derived from them are added to the next level's.
+		// Each thread claims a batch of them from remaining, takes it in bulk, and adds what it derived in bulk
+		template <bool low_mem, typename T, typename QueueContainer, typename Types, typename DoneStripes>
+		void worker_cq(code_machina::BlockingCollection<T, QueueContainer>* const& level,
+						code_machina::BlockingCollection<T, QueueContainer>* const& next,
+						std::atomic<std::int64_t>& remaining,
+						const typename Types::size_type& batch_size,
+						SpinBarrier<>& go,
+						SpinBarrier<>& wait,
+						const bool& exit,
+						const typename Types::size_type& depth,
+						const CompiledRules<Types>& rules,
+						typename Types::node_arena& arena,
+						DoneStripes& done_strings)
 		{
-			while (!done_queue.is_completed()) {
-				T s;
-				auto status = done_queue.take(s);
-				if (status != code_machina::BlockingCollectionStatus::Ok) {
-					continue;
+			std::vector<T> batch;
+			std::vector<T> done;
+			// the queue merges the strings derived twice (see QueueContainer)
+			std::vector<T> new_strings;
+			while (true) {
+				Stats<Types>::barrier_wait(go);
+				if (exit)
+					break;
+				std::int64_t left;
+				while ((left = remaining.fetch_sub(static_cast<std::int64_t>(batch_size), std::memory_order_relaxed)) > 0) {
+					typename Types::size_type count = std::min<typename Types::size_type>(batch_size, static_cast<typename Types::size_type>(left));
+					// the claimed strings are on the queue already
+					batch.resize(count);
+					for (typename Types::size_type taken = 0, n; taken < count; taken += n) {
+						Stats<Types>::queue_wait([&]() { return level->take_bulk(batch.begin() + static_cast<std::ptrdiff_t>(taken), count - taken, n); });
+					}
+					for (auto& s: batch) {
+						// find the first nonterminal
+						typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+						if (pos == Types::string_type::npos) {  // no nonterminal found, string done
+							Stats<Types>::finished();
+							done.push_back(std::move(s));
+							continue;
+						}
+						Stats<Types>::expanded(depth);
+						// do all derivations possible
+						const auto& substitutions = rules.at(Types::functions::at(s, pos));
+						for (auto& substitution: substitutions) {
+							if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+								continue;
+							new_strings.push_back(derivate<low_mem, Types>(s, pos, substitution, rules, arena));
+						}
+					}
+					typename Types::size_type added;
+					Stats<Types>::queue_wait([&]() { return next->add_bulk(std::make_move_iterator(new_strings.begin()), std::make_move_iterator(new_strings.end()), added); });
+					new_strings.clear();
+					done_strings.insert_bulk(done);
 				}
-				done_strings.insert(done_strings.end(), std::move(s));
+				// tell main thread that we are finished
+				Stats<Types>::barrier_wait(wait);
 			}
 		}
 		
 		// controlled queue string generator
 		// the queue is controlled by the main thread and it controls when the threads should stop
-		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_controlled_queue(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_controlled_queue(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+										WorkerPool& pool, typename Types::size_type num_of_threads,
+										DoneContainer& done_strings)
 		{
 			if (depth == 0)
-				return OutContainer();
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
-			}
+				return;
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
 		
-			code_machina::BlockingCollection<T, QueueContainer> queue;
-			code_machina::BlockingCollection<T> done_queue(100);
-			// initial string
-			queue.add(Types::functions::new_string("S", std::bool_constant<derivation>{}));
-			OutContainer done_strings;
+			// a queue per level, so a string isn't merged with an equal one of another level (with derivations
+			// of another length). The threads take from level and add to next, swapped after each level
+			code_machina::BlockingCollection<T, QueueContainer> queues[2];
+			code_machina::BlockingCollection<T, QueueContainer>* level = &queues[0];
+			code_machina::BlockingCollection<T, QueueContainer>* next = &queues[1];
+			StripedContainer<merge_derivations, DoneContainer, Types> done_stripes(done_strings, num_of_threads);
+			// initial strings
+			typename Types::size_type added;
+			level->add_bulk(std::make_move_iterator(seeds.begin()), std::make_move_iterator(seeds.end()), added);
 		
-			std::thread workers[NUM_OF_THREADS];
-			Barrier go(NUM_OF_THREADS + 1);
-			Barrier wait(NUM_OF_THREADS + 1);
+			SpinBarrier<> go(num_of_threads + 1);
+			SpinBarrier<> wait(num_of_threads + 1);
 			bool exit = false;
-			// theses "nulls" informs the thread to stop and wait
-			std::array<T, NUM_OF_THREADS> nulls; 
-			// generate a string with a null character but with a size > 0
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				nulls[i] = Types::functions::new_string(std::move(std::to_string(i) + std::to_string(i)), std::bool_constant<derivation>{});
-				Types::functions::at(nulls[i], 0) = '\0';
-			}
-			typename Types::size_type dummy = NUM_OF_THREADS;
-			queue.add_bulk(nulls.begin(), nulls.end(), dummy);
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				workers[i] = std::thread(worker_cq<low_mem, T, OutContainer, QueueContainer, Types>, std::ref(queue),
-										std::ref(go), std::ref(wait),
-										std::ref(exit),
-										std::ref(nonterminals), std::ref(rules),
-										std::ref(done_queue));
-			}
-			std::thread done_guard_thread(done_guard<T, OutContainer>,
-								std::ref(done_queue), std::ref(done_strings));
+			// the strings of the level not claimed yet, and how many a thread claims at once
+			std::atomic<std::int64_t> remaining = {0};
+			typename Types::size_type batch_size = 1;
+			// the derivation nodes of each thread, alive until the strings are done
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
+			pool.run(num_of_threads, Stats<Types>::task([&](typename Types::size_type i) {
+				worker_cq<low_mem, T, QueueContainer, Types>(level, next, remaining, batch_size, go, wait, exit, depth, rules, arenas[i], done_stripes);
+			}));
 		
-			wait.Wait();
-			depth--;
 			for (;depth > 0; depth--) {
-				// add nulls and release the threads
-				queue.add_bulk(nulls.begin(), nulls.end(), dummy);
-				go.Wait();
-				wait.Wait();
+				// the threads are waiting, so the queues aren't changing
+				typename Types::size_type size = level->size();
+				Stats<Types>::frontier(depth, size);
+				remaining = static_cast<std::int64_t>(size);
+				batch_size = QueueBatch::of(size, num_of_threads);
+				Stats<Types>::barrier_wait(go);
+				Stats<Types>::barrier_wait(wait);
+				std::swap(level, next);
 			}
 			// final depth generated, tell threads to exit
 			exit = true;
-			go.Wait();
-			queue.complete_adding();
+			Stats<Types>::frontier(depth, level->size());
+			Stats<Types>::barrier_wait(go);
+			level->complete_adding();
 			// get done strings from the queue
-			while (!queue.is_completed()) {
-				T s; 
-				auto status = queue.take(s);
-				if (status != code_machina::BlockingCollectionStatus::Ok) {
-					continue;
+			std::vector<T> batch(QueueBatch::max);
+			std::vector<T> done;
+			typename Types::size_type taken;
+			while (level->take_bulk(batch.begin(), batch.size(), taken) == code_machina::BlockingCollectionStatus::Ok) {
+				for (typename Types::size_type i = 0; i < taken; i++) {
+					typename Types::size_type pos = Types::functions::find_nonterminal(batch[i], rules);
+					if (pos == Types::string_type::npos) {
+						Stats<Types>::finished();
+						done.push_back(std::move(batch[i]));
+					}
 				}
+				done_stripes.insert_bulk(done);
+			}
+			pool.wait();
+			done_stripes.merge_into(done_strings);
+		}
 		
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
-				if (pos == Types::string_type::npos) {
-					done_queue.add(std::move(s));
+		// a free queue's container, that counts the strings it's given that aren't merged into one it has on its
+		// own counter. With the strings being derived from, the workers take off it when they're done with a
+		// batch, so it's 0 when the free queue is done. The BlockingCollection constructs its container, so the
+		// counter is handed over by a Scope alive while the BlockingCollection is constructed
+		template <typename Container>
+		class CountingQueueContainer : public Container {
+		public:
+			// the counter of the container constructed on this thread while it's alive
+			class Scope {
+			public:
+				Scope() { constructing() = &counter; }
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+				~Scope() { constructing() = nullptr; }
+
+				std::atomic<std::size_t>& pending() const
+				{
+					if (counter == nullptr)
+						throw std::logic_error("cfg_string_generator: no queue container was constructed in the scope");
+					return *counter;
 				}
+
+			private:
+				std::atomic<std::size_t>* counter = nullptr;
+			};
+
+			CountingQueueContainer()
+			{
+				if (constructing() != nullptr)
+					*constructing() = &pending;
 			}
-			done_queue.complete_adding();
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				workers[i].join();
+
+			template <typename V>
+			bool try_add(V&& value)
+			{
+				auto before = Container::size();
+				bool added = Container::try_add(std::forward<V>(value));
+				if (Container::size() > before)
+					pending.fetch_add(1, std::memory_order_relaxed);
+				return added;
 			}
-			done_guard_thread.join();
-		
-			return done_strings;
-		}
-		
+
+		private:
+			// where the Scope on this thread, if any, wants the counter
+			static std::atomic<std::size_t>**& constructing()
+			{
+				thread_local std::atomic<std::size_t>** counter = nullptr;
+				return counter;
+			}
+
+			std::atomic<std::size_t> pending = {0};
+		};
+
 		// free queue algorithm's worker thread
-		template <bool low_mem, typename T, typename Container, typename Types>
-		void worker_fq_map(code_machina::BlockingCollection<T, Container>& queue,
-						std::atomic_uintmax_t& wait_counter,
+		// takes a batch of strings at once and adds what it derived from them in bulk. The thread that
+		// finishes the last string completes the queue, the ones waiting on it are woken up and return
+		template <bool low_mem, typename T, typename Container, typename Types, typename DoneStripes>
+		void worker_fq_map(code_machina::BlockingCollection<T, CountingQueueContainer<Container>>& queue,
+						std::atomic<std::size_t>& pending,
+						typename Types::size_type num_of_threads,
 						typename Types::size_type depth,
-						const typename Types::string_type& nonterminals,
-						const typename Types::auto_t::rules_type& rules,
-						code_machina::BlockingCollection<T>& done_queue)
+						const CompiledRules<Types>& rules,
+						typename Types::node_arena& arena,
+						DoneStripes& done_strings)
 		{
-			while (!queue.is_completed()) {
-				T s; 
-				// check if we are stuck with an empty queue.
+			std::vector<T> batch;
+			std::vector<T> done;
+			std::vector<T> new_strings;
+			while (true) {
+				batch.resize(QueueBatch::of(queue.size(), num_of_threads));
+				// parks until there's a string, or the queue is completed
+				typename Types::size_type taken;
+				if (Stats<Types>::queue_wait([&]() { return queue.take_bulk(batch.begin(), batch.size(), taken); }) != code_machina::BlockingCollectionStatus::Ok)
+					break;
 		
-				// NUM_OF_THREADS - 1 (all worker threads except this one) incremented the counter
-				// but didn't decrement after queue.take() (yet, possibly)
-				if (wait_counter.fetch_add(1, std::memory_order_release) == NUM_OF_THREADS - 1) {
-					// the queue is empty, but a thread could just have taken an element
-					// from the queue
-					if (queue.size() == 0) {
-						// NUM_OF_THREADS - 1 (all worker threads except this one) are
-						// waiting on the queue lock, they're probably stuck
-						if (queue.active_consumers() == 0) {
-							// last confirmation, a safe guard (maybe unnecessary)
-							if (wait_counter.load(std::memory_order_release) == NUM_OF_THREADS) {
-								// all strings were processed
-								queue.complete_adding();
-								done_queue.complete_adding();
-								break;
-							}
-						}
+				for (typename Types::size_type i = 0; i < taken; i++) {
+					T& s = batch[i];
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+					if (pos == Types::string_type::npos) {
+						Stats<Types>::finished();
+						done.push_back(std::move(s));
+						continue;
+					}
+					// the derivations that reached the depth stop here
+					s.second.erase(std::remove_if(s.second.begin(), s.second.end(),
+													[depth](auto derivation) { return Types::functions::size(derivation) >= depth; }),
+									s.second.end());
+					if (s.second.empty())
+						continue;
+					// the shortest derivation has the most derivations left
+					typename Types::size_type shortest = depth;
+					for (auto derivation: s.second) {
+						shortest = std::min(shortest, Types::functions::size(derivation));
+					}
+					Stats<Types>::expanded(depth - shortest);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - shortest - 1))
+							continue;
+						new_strings.push_back(derivate<low_mem, Types>(s, pos, substitution, rules, arena));
 					}
 				}
-				auto status = queue.take(s);
-				wait_counter.fetch_sub(1, std::memory_order_release);
-				if (status != code_machina::BlockingCollectionStatus::Ok) {
+				// counted before the batch is done with, so pending doesn't reach 0 while there's strings to derive
+				typename Types::size_type added;
+				Stats<Types>::queue_wait([&]() { return queue.add_bulk(std::make_move_iterator(new_strings.begin()), std::make_move_iterator(new_strings.end()), added); });
+				new_strings.clear();
+				done_strings.insert_bulk(done);
+				if (pending.fetch_sub(taken, std::memory_order_acq_rel) == taken)
+					queue.complete_adding();
+			}
+		}
+		
+		// free queue string gen
+		// free queue differs from controlled queue by letting threads manage themselves.
+		// It ends when no string is on the queue or being derived from, counted by pending
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_free_queue(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+									WorkerPool& pool, typename Types::size_type num_of_threads,
+									DoneContainer& done_strings)
+		{
+			if (depth == 0)
+				return;
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
+		
+			typename CountingQueueContainer<QueueContainer>::Scope scope;
+			code_machina::BlockingCollection<T, CountingQueueContainer<QueueContainer>> queue;
+			std::atomic<std::size_t>& pending = scope.pending();
+			StripedContainer<merge_derivations, DoneContainer, Types> done_stripes(done_strings, num_of_threads);
+			typename Types::size_type added;
+			queue.add_bulk(std::make_move_iterator(seeds.begin()), std::make_move_iterator(seeds.end()), added);
+			if (pending.load() == 0)
+				queue.complete_adding();
+		
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
+			pool.run(num_of_threads, Stats<Types>::task([&](typename Types::size_type i) {
+				worker_fq_map<low_mem, T, QueueContainer, Types>(queue, pending, num_of_threads, depth,
+																rules, arenas[i], done_stripes);
+			}));
+			pool.wait();
+			done_stripes.merge_into(done_strings);
+		}
+
+		// a string on the work stealing deques and how many derivations it can still do
+		template <typename T, typename Types>
+		struct WorkItem {
+			T s;
+			typename Types::size_type depth;
+		};
+
+		// a work stealing thread's work items, reused instead of freed, so pushing a string doesn't allocate once
+		// the thread has had as many at once. An item goes back to the pool of the thread done with it, not
+		// always the one that made it, so the pools live until every thread is done
+		template <typename T, typename Types>
+		class alignas(64) WorkItemPool {
+		public:
+			WorkItem<T, Types>* make(T&& s, typename Types::size_type depth)
+			{
+				if (free.empty()) {
+					items.emplace_back();
+					free.push_back(&items.back());
+				}
+				WorkItem<T, Types>* item = free.back();
+				free.pop_back();
+				item->s = std::move(s);
+				item->depth = depth;
+				return item;
+			}
+
+			// the string is dropped now, not when the item is reused
+			void recycle(WorkItem<T, Types>* item)
+			{
+				item->s = T();
+				free.push_back(item);
+			}
+
+		private:
+			// a deque doesn't move them as it grows
+			std::deque<WorkItem<T, Types>> items;
+			std::vector<WorkItem<T, Types>*> free;
+		};
+
+		// where the work stealing threads with nothing to steal sleep, until strings are pushed or the generation ends
+		struct IdleWorkers {
+			std::atomic<std::size_t> parked = {0};
+			// bumped under the mutex on each wake
+			std::atomic<std::size_t> signals = {0};
+			std::mutex mutex;
+			std::condition_variable condition;
+
+			// after pushing strings on a deque. seq_cst with the parking's, a thread parking either
+			// steals the strings or is seen parked
+			void pushed()
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (parked.load(std::memory_order_relaxed) != 0)
+					wake();
+			}
+
+			void wake()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					signals.fetch_add(1, std::memory_order_relaxed);
+				}
+				condition.notify_all();
+			}
+		};
+
+		// work stealing algorithm's worker thread
+		// pending counts the work items alive (on a deque or being derived)
+		template <bool low_mem, bool merge_derivations, typename T, typename OutContainer, typename Types>
+		void worker_ws(typename Types::size_type id,
+						typename Types::size_type num_of_threads,
+						WorkStealingDeque<WorkItem<T, Types>>* deques,
+						WorkItemPool<T, Types>& items,
+						IdleWorkers& idle,
+						std::atomic<typename Types::size_type>& pending,
+						const CompiledRules<Types>& rules,
+						typename Types::node_arena& arena,
+						OutContainer& done_strings)
+		{
+			auto& own = deques[id];
+			WorkItem<T, Types>* item = nullptr;
+			while (true) {
+				if (item == nullptr)
+					item = own.pop();
+				// nothing to do locally, try to steal from the other threads
+				for (typename Types::size_type i = 1; item == nullptr && i < num_of_threads; i++) {
+					item = deques[(id + i) % num_of_threads].steal();
+				}
+				if (item == nullptr) {
+					if (pending.load(std::memory_order_acquire) == 0)
+						break;
+					// park, then try stealing once more: a push after it wakes this thread
+					auto seen = idle.signals.load(std::memory_order_acquire);
+					idle.parked.fetch_add(1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					for (typename Types::size_type i = 1; item == nullptr && i < num_of_threads; i++) {
+						item = deques[(id + i) % num_of_threads].steal();
+					}
+					if (item == nullptr) {
+						std::unique_lock<std::mutex> lock(idle.mutex);
+						idle.condition.wait(lock, [&] {
+							return idle.signals.load(std::memory_order_relaxed) != seen
+								|| pending.load(std::memory_order_acquire) == 0;
+						});
+					}
+					idle.parked.fetch_sub(1, std::memory_order_relaxed);
 					continue;
 				}
-		
-				// optimization: derivate one string and them just copy it
-				// possibly prevents copying without new derivation -> adding derivation -> reallocation
-				// but this increase copy size. the method from controlled queue also works here.
-				// more testing is needed
 
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
-				if (pos == Types::string_type::npos) {
-					done_queue.add(std::move(s));
+				typename Types::size_type pos = Types::functions::find_nonterminal(item->s, rules);
+				if (pos == Types::string_type::npos) {  // no nonterminal found, string done
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, std::move(item->s));
+				}
+				// the derivations that can still be finished
+				typename Types::size_type fitting = 0;
+				if (pos != Types::string_type::npos && item->depth > 0) {
+					Stats<Types>::expanded(item->depth);
+					for (auto& substitution: rules.at(Types::functions::at(item->s, pos))) {
+						if (Types::functions::fits(item->s, pos, substitution, rules, item->depth - 1))
+							fitting++;
+					}
+				}
+				if (fitting == 0) {
+					items.recycle(item);
+					item = nullptr;
+					// the last one wakes the parked threads to end
+					if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						idle.wake();
 					continue;
 				}
-				const auto& nonterminal = Types::functions::at(s, pos);
-				const auto* substitution = &(rules.at(nonterminal).front());
-				decltype(s.second) derivations;  //! ugly time saving hack
-				for (auto& derivation: s.second) {
-					if (derivation.size() >= depth)
+
+				const auto& substitutions = rules.at(Types::functions::at(item->s, pos));
+				// this item becomes the last derivation, so it's counted already
+				pending.fetch_add(fitting - 1, std::memory_order_relaxed);
+				const typename Types::substitution_type* last = nullptr;
+				for (auto& substitution: substitutions) {
+					if (!Types::functions::fits(item->s, pos, substitution, rules, item->depth - 1))
 						continue;
-					derivations.push_back(std::move(derivation));
-					if constexpr(low_mem)
-						derivations.back().push_back(substitution);
-					else
-						derivations.back().push_back({pos, substitution});
-				}
-				if (derivations.size() == 0) continue;
-				//? Should we do it?
-				//// s.second.clear()
-				typename Types::string_type new_string(s.first);
-				new_string.replace(pos, 1, *substitution);
-				// TODO: can be emplaced
-				T t = {new_string, derivations};
-				queue.add(t);
-		
-		
-				for (auto it = ++rules.at(nonterminal).begin(); it != rules.at(nonterminal).end(); it++) {
-					substitution = &(*it);
-					for (auto& derivation: derivations) {
-						if constexpr(low_mem)
-							derivation.back() = substitution;
-						else
-							derivation.back() = {pos, substitution};
+					if (last != nullptr)
+						own.push(items.make(derivate<low_mem, Types>(item->s, pos, *last, rules, arena), item->depth - 1));
+					last = &substitution;
+				}
+				if (fitting > 1)
+					idle.pushed();
+				// keep working on the last one, saving a trip through the deque
+				item->s = derivate<low_mem, Types>(item->s, pos, *last, rules, arena);
+				item->depth--;
+			}
+		}
+
+		// work stealing string generator
+		// each thread has its own deque of strings to derivate and steals from
+		// the others when it's empty, so there's no shared queue to contend on.
+		// There's no notion of a depth level: each string carries its remaining depth
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_work_stealing(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+										WorkerPool& pool, typename Types::size_type num_of_threads,
+										DoneContainer& done_strings)
+		{
+			if (depth == 0)
+				return;
+			// same semantics as the additive queue: duplicates keep all derivations
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
+
+			std::unique_ptr<WorkStealingDeque<WorkItem<T, Types>>[]> deques(new WorkStealingDeque<WorkItem<T, Types>>[num_of_threads]);
+			std::vector<WorkItemPool<T, Types>> items(num_of_threads);
+			IdleWorkers idle;
+			std::atomic<typename Types::size_type> pending = {seeds.size()};
+			// initial strings, spread between the threads
+			for (typename Types::size_type i = 0; i < seeds.size(); i++) {
+				deques[i % num_of_threads].push(items[i % num_of_threads].make(std::move(seeds[i]), depth));
+			}
+
+			std::vector<DoneContainer> results_done(num_of_threads, new_done_slot(done_strings));
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
+			pool.run(num_of_threads, Stats<Types>::task([&](typename Types::size_type i) {
+				worker_ws<low_mem, merge_derivations, T, DoneContainer, Types>(i, num_of_threads, deques.get(), items[i], idle, pending,
+																			rules, arenas[i], results_done[i]);
+			}));
+			pool.wait();
+
+			for (typename Types::size_type i = 0; i < num_of_threads; i++) {
+				merge_done<merge_derivations, Types>(results_done[i], done_strings);
+			}
+		}
+
+		// strings given away by the depth first threads to the idle ones
+		template <typename T, typename Types>
+		struct SharedStack {
+			std::mutex mutex;
+			std::condition_variable cond;
+			std::vector<WorkItem<T, Types>> items;
+			// threads with strings on their stacks
+			typename Types::size_type active = 0;
+			bool finished = false;
+			// threads waiting for strings
+			std::atomic<typename Types::size_type> hungry = {0};
+		};
+
+		// depth first algorithm's worker thread
+		// the strings are derived from an explicit stack, so at most depth * (biggest rule count)
+		// strings are alive per thread. When a thread is idle, the others give it the bottom
+		// of their stacks, which are the shallowest strings, and so the biggest subtrees
+		template <bool low_mem, bool merge_derivations, typename T, typename DoneContainer, typename Types>
+		void worker_df(SharedStack<T, Types>& shared,
+						const CompiledRules<Types>& rules,
+						typename Types::node_arena& arena,
+						DoneContainer& done_strings)
+		{
+			std::vector<WorkItem<T, Types>> stack;
+			bool active = false;
+			while (true) {
+				if (stack.empty()) {
+					std::unique_lock<std::mutex> lock(shared.mutex);
+					if (active) {
+						shared.active--;
+						active = false;
+					}
+					// nobody has strings to derive or to give away, we're done
+					if (shared.items.empty() && shared.active == 0) {
+						shared.finished = true;
+						lock.unlock();
+						shared.cond.notify_all();
+						break;
 					}
-					typename Types::string_type new_string(s.first, std::false_type{});
-					new_string.replace(pos, 1, *substitution);
-					T t = {new_string, derivations};
-					queue.add(t);
+					shared.hungry++;
+					shared.cond.wait(lock, [&shared] { return !shared.items.empty() || shared.finished; });
+					shared.hungry--;
+					if (shared.items.empty())
+						break;
+					stack.push_back(std::move(shared.items.back()));
+					shared.items.pop_back();
+					shared.active++;
+					active = true;
+				}
+
+				WorkItem<T, Types> item = std::move(stack.back());
+				stack.pop_back();
+
+				// split the work with the idle threads
+				typename Types::size_type hungry = shared.hungry.load(std::memory_order_relaxed);
+				if (hungry > 0 && !stack.empty()) {
+					typename Types::size_type given = std::min<typename Types::size_type>(hungry, stack.size());
+					{
+						std::lock_guard<std::mutex> lock(shared.mutex);
+						std::move(stack.begin(), stack.begin() + given, std::back_inserter(shared.items));
+					}
+					stack.erase(stack.begin(), stack.begin() + given);
+					shared.cond.notify_all();
+				}
+
+				typename Types::size_type pos = Types::functions::find_nonterminal(item.s, rules);
+				if (pos == Types::string_type::npos) {  // no nonterminal found, string done
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, std::move(item.s));
+					continue;
+				}
+				if (item.depth == 0)
+					continue;
+				Stats<Types>::expanded(item.depth);
+				const auto& substitutions = rules.at(Types::functions::at(item.s, pos));
+				// reversed, so the first substitution is derived first
+				for (auto it = substitutions.rbegin(); it != substitutions.rend(); it++) {
+					if (!Types::functions::fits(item.s, pos, *it, rules, item.depth - 1))
+						continue;
+					stack.push_back({derivate<low_mem, Types>(item.s, pos, *it, rules, arena), item.depth - 1});
 				}
 			}
 		}
-		
-		// free queue string gen
-		// free queue differs from controlled queue by letting threads manage themselves
-		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_free_queue(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+
+		// depth first string generator
+		// the memory used is bounded by depth, instead of growing with the number of strings on a depth level
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_depth_first(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+								WorkerPool& pool, typename Types::size_type num_of_threads,
+								DoneContainer& done_strings)
 		{
 			if (depth == 0)
-				return OutContainer();
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
+				return;
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
+
+			SharedStack<T, Types> shared;
+			// initial strings
+			for (auto& s: seeds) {
+				shared.items.push_back({std::move(s), depth});
 			}
-		
-			code_machina::BlockingCollection<T, QueueContainer> queue;
-			code_machina::BlockingCollection<T> done_queue(100);
-			queue.add(Types::functions::new_string("S", std::bool_constant<derivation>{}));
-			OutContainer done_strings;
-		
-			std::thread workers[NUM_OF_THREADS];
-			std::atomic_uintmax_t wait_counter = {0};
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				workers[i] = std::thread(worker_fq_map<low_mem, T, QueueContainer, Types>, std::ref(queue),
-										std::ref(wait_counter), depth,
-										std::ref(nonterminals), std::ref(rules),
-										std::ref(done_queue));
-			}
-			std::thread done_guard_thread(done_guard<T, OutContainer>,
-								std::ref(done_queue), std::ref(done_strings));
-		
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				workers[i].join();
+
+			std::vector<DoneContainer> results_done(num_of_threads, new_done_slot(done_strings));
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
+			pool.run(num_of_threads, Stats<Types>::task([&](typename Types::size_type i) {
+				worker_df<low_mem, merge_derivations, T, DoneContainer, Types>(shared, rules, arenas[i], results_done[i]);
+			}));
+			pool.wait();
+
+			for (typename Types::size_type i = 0; i < num_of_threads; i++) {
+				merge_done<merge_derivations, Types>(results_done[i], done_strings);
 			}
-			done_guard_thread.join();
-		
-			return done_strings;
 		}
-		
+
+		// if the strings are reached by index, so a slice is found in constant time
+		// and the next level can be written in place
+		template <typename Container>
+		constexpr bool random_access_v = std::is_base_of_v<std::random_access_iterator_tag,
+															typename std::iterator_traits<typename Container::iterator>::iterator_category>;
+
+		template <typename Container, typename = void>
+		struct has_buckets : std::false_type {};
+		template <typename Container>
+		struct has_buckets<Container, std::void_t<decltype(std::declval<const Container&>().bucket_count())>> : std::true_type {};
+
+		// calls f on the strings of slice i of num_of_threads. Random access containers are split by position
+		// and unordered ones by bucket, so no thread walks the container to find its slice
+		template <typename Container, typename size_type, typename F>
+		void for_each_in_slice(Container& strings, size_type i, size_type num_of_threads, F f)
+		{
+			if constexpr(random_access_v<Container>) {
+				size_type slice = strings.size()/num_of_threads;
+				auto start = strings.begin() + i*slice;
+				auto end = i == num_of_threads - 1 ? strings.end() : start + slice;
+				for (auto it = start; it != end; it++) {
+					f(*it);
+				}
+			}
+			else if constexpr(has_buckets<Container>::value) {
+				size_type buckets = strings.bucket_count();
+				for (size_type b = i*buckets/num_of_threads; b < (i + 1)*buckets/num_of_threads; b++) {
+					for (auto it = strings.begin(b); it != strings.end(b); it++) {
+						f(*it);
+					}
+				}
+			}
+			else {
+				size_type slice = strings.size()/num_of_threads;
+				auto start = std::next(strings.begin(), i*slice);
+				auto end = i == num_of_threads - 1 ? strings.end() : std::next(start, slice);
+				for (auto it = start; it != end; it++) {
+					f(*it);
+				}
+			}
+		}
+
 		// dual container algorithm's worker thread
-		template <bool derivation, bool low_mem, typename Container, typename Types>
-		void worker_dc(const typename Container::iterator& start,
-						const typename Container::iterator& end,
-						Barrier& go,
-						Barrier& wait,
+		// in_place: the threads first count the strings they'll derive, then write them to their place
+		// on next, given by offsets (the counts' prefix sum, taken when they cross counted). Otherwise they go to new_strings
+		template <bool low_mem, bool merge_derivations, bool in_place, typename Container, typename DoneContainer, typename Types, typename CountedBarrier>
+		void worker_dc(Container& strings,
+						typename Types::size_type i,
+						typename Types::size_type num_of_threads,
+						Container& next,
+						std::vector<typename Types::size_type>& offsets,
+						CountedBarrier& counted,
+						SpinBarrier<>& go,
+						SpinBarrier<>& wait,
 						const bool& exit,
-						const typename Types::string_type& nonterminals,
-						const typename Types::auto_t::rules_type& rules,
-						Container& done_strings,
+						const typename Types::size_type& depth,
+						const CompiledRules<Types>& rules,
+						typename Types::node_arena& arena,
+						LevelArenas& level_arenas,
+						DoneContainer& done_strings,
 						Container& new_strings)
 		{
+			FormResourceScope scope;
 			while (true) {
-				go.Wait();
+				Stats<Types>::barrier_wait(go);
 				done_strings.clear();
 				new_strings.clear();
 				if (exit) {
 					break;
 				}
-		
-				for (auto it = start; it != end; it++) {
-					auto& s = *it;
-					typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
-					if (pos == Types::string_type::npos) {
-						done_strings.insert(done_strings.end(), std::move(s));
-						continue;
-					}
-					for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
-						if constexpr(derivation) {
-							auto new_string = Types::functions::template derivate<low_mem>(s, pos, substitution);
-							auto [it, success] = new_strings.insert(new_string);
-							// TODO: support no repetition mode, somehow
-							if (!success)
-								Types::functions::merge(new_string.second, it->second);
+				if constexpr(arena_string_v<typename Types::form_string_type>)
+					scope.use(level_arenas.of(depth));
+
+				if constexpr(in_place) {
+					typename Types::size_type count = 0;
+					for_each_in_slice(strings, i, num_of_threads, [&](auto& s) {
+						typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+						if (pos == Types::string_type::npos) {
+							Stats<Types>::finished();
+							insert_done<merge_derivations, Types>(done_strings, std::move(s));
+							return;
 						}
-						else {
-							new_strings.insert(new_strings.end(), Types::functions::template derivate<low_mem>(s, pos, substitution));
+						Stats<Types>::expanded(depth);
+						for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
+							count += Types::functions::fits(s, pos, substitution, rules, depth - 1);
 						}
-					}
+					});
+					offsets[i] = count;
+					// counted's completion turns the counts into offsets
+					Stats<Types>::barrier_wait(counted);
+					typename Types::size_type offset = offsets[i];
+					for_each_in_slice(strings, i, num_of_threads, [&](auto& s) {
+						typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+						if (pos == Types::string_type::npos)
+							return;
+						for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
+							if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+								continue;
+							next[offset++] = derivate<low_mem, Types>(s, pos, substitution, rules, arena);
+						}
+					});
 				}
-				wait.Wait();
+				else {
+					for_each_in_slice(strings, i, num_of_threads, [&](auto& s) {
+						typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+						if (pos == Types::string_type::npos) {
+							Stats<Types>::finished();
+							insert_done<merge_derivations, Types>(done_strings, std::move(s));
+							return;
+						}
+						Stats<Types>::expanded(depth);
+						const auto& substitutions = rules.at(Types::functions::at(s, pos));
+						for (auto& substitution: substitutions) {
+							if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+								continue;
+							insert_form<merge_derivations, Types>(new_strings, derivate<low_mem, Types>(s, pos, substitution, rules, arena));
+						}
+					});
+				}
+				Stats<Types>::barrier_wait(wait);
 			}
 		}
 		
 		// dual containers string generator
 		// this algorithm uses two containers, one with the strings to be derived
-		// and one with the newly derivated strings. The first is replaced with the second at the end of derivation
-		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_dual_containers(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+		// and one with the newly derivated strings. The first is replaced with the second at the end of derivation.
+		// When the strings are in a random access container (with repetition), each thread writes the strings it
+		// derives straight to their place on the next level, so they're moved once.
+		// Forms with arena strings (see ArenaTypeDefs) are derived on each thread's LevelArenas
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_dual_containers(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+										WorkerPool& pool, typename Types::size_type num_of_threads,
+										DoneContainer& done_strings)
 		{
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
+			constexpr bool level_arenas = arena_string_v<typename Types::form_string_type>;
+			// equal forms and done strings are merged, with their derivations too if there's repetition
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
+			// moving a form to a place on next, a string from another arena, would copy it
+			constexpr bool in_place = std::is_same_v<OutContainer, typename Types::auto_t::repetition_form_container> && random_access_v<OutContainer> && !level_arenas;
+			// declared before the forms, that free their strings on them
+			std::vector<LevelArenas> arenas_of_levels(level_arenas ? num_of_threads : 0);
+			OutContainer strings;
+			typename Types::node_arena arena;
+			for (auto& s: seeds) {
+				insert_form<merge_derivations, Types>(strings, std::move(s));
 			}
-			OutContainer strings = {Types::functions::new_string("S", std::bool_constant<derivation>{})};
-			OutContainer done_strings;
 		
 			// initial generation. Does it until there's enough strings to feed to threads
-			for (;depth > 0 && strings.size() < NUM_OF_THREADS; depth--) {
+			for (;depth > 0 && strings.size() < num_of_threads; depth--) {
+				Stats<Types>::frontier(depth, strings.size());
 				OutContainer new_strings;
 				for (auto& s: strings) {
-					typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 					if (pos == Types::string_type::npos) {
-						done_strings.insert(done_strings.end(), std::move(s));
+						Stats<Types>::finished();
+						insert_done<merge_derivations, Types>(done_strings, std::move(s));
 						continue;
 					}
-					for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
-						new_strings.insert(new_strings.end(), Types::functions::template derivate<low_mem>(s, pos, substitution));
+					Stats<Types>::expanded(depth);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+							continue;
+						insert_form<merge_derivations, Types>(new_strings, derivate<low_mem, Types>(s, pos, substitution, rules, arena));
 					}
 				}
 				strings = std::move(new_strings);
 			}
 			// we finshed early
 			if (depth == 0) {
+				Stats<Types>::frontier(depth, strings.size());
 				for (auto& s: strings) {
-					typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 					if (pos == Types::string_type::npos) {
-						done_strings.insert(done_strings.end(), std::move(s));
+						Stats<Types>::finished();
+						insert_done<merge_derivations, Types>(done_strings, std::move(s));
 						continue;
 					}
 				}
-				return done_strings;
+				return;
 			}
 		
-			std::thread threads[NUM_OF_THREADS];
-			typename OutContainer::iterator start[NUM_OF_THREADS];
-			typename OutContainer::iterator end[NUM_OF_THREADS];
-			Barrier go(NUM_OF_THREADS + 1);
-			Barrier wait(NUM_OF_THREADS + 1);
-			OutContainer results_done[NUM_OF_THREADS];
-			OutContainer results_strings[NUM_OF_THREADS];
+			OutContainer next;
+			std::vector<typename Types::size_type> offsets(num_of_threads);
+			// the last thread to count its strings makes room for them on next
+			auto make_room = [&offsets, &next]() {
+				if constexpr(in_place) {
+					typename Types::size_type total = 0;
+					for (auto& offset: offsets) {
+						typename Types::size_type count = offset;
+						offset = total;
+						total += count;
+					}
+					next.resize(total);
+				}
+			};
+			SpinBarrier<decltype(make_room)> counted(num_of_threads + 1, make_room);
+			SpinBarrier<> go(num_of_threads + 1);
+			SpinBarrier<> wait(num_of_threads + 1);
+			std::vector<DoneContainer> results_done(num_of_threads, new_done_slot(done_strings));
+			std::vector<OutContainer> results_strings(num_of_threads);
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
 			bool exit = false;
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				threads[i] = std::thread(worker_dc<derivation, low_mem, OutContainer, Types>,
-										std::ref(start[i]), std::ref(end[i]), std::ref(go), std::ref(wait),
-										std::ref(exit), std::ref(nonterminals), std::ref(rules),
-										std::ref(results_done[i]), std::ref(results_strings[i]));
-			}
+			LevelArenas no_arenas;
+			pool.run(num_of_threads, Stats<Types>::task([&](typename Types::size_type i) {
+				worker_dc<low_mem, merge_derivations, in_place, OutContainer, DoneContainer, Types>(strings, i, num_of_threads, next, offsets, counted, go, wait, exit, depth, rules,
+																	arenas[i], level_arenas ? arenas_of_levels[i] : no_arenas, results_done[i], results_strings[i]);
+			}));
 		
-			// split the container, getting the start and end iterator of the slices
-			// these iterators are given to the threads
 			for (;depth > 0; depth--) {
-				typename Types::size_type slice = strings.size()/NUM_OF_THREADS;
-				start[0] = strings.begin();
-				end[0] = std::next(start[0], slice);
-				for (typename Types::size_type i = 1; i < NUM_OF_THREADS - 1; i++) {
-					start[i] = end[i-1];
-					end[i] = std::next(start[i], slice);
-				}
-				start[NUM_OF_THREADS - 1] = end[NUM_OF_THREADS - 2];
-				end[NUM_OF_THREADS - 1] = strings.end();
-				go.Wait();
-		
-				//  extract the generated strings from the threads
-				// TODO: possible optimization: clear the strings container and add
-				// the new strings directly, so we move strings just once, intead of twice
-				// also doable with done_strings, but without the clear call
+				// the forms derived two levels ago were read on the last one
+				for (auto& level_arena: arenas_of_levels) {
+					level_arena.release(depth);
+				}
+				Stats<Types>::frontier(depth, strings.size());
+				Stats<Types>::barrier_wait(go);
+				if constexpr(in_place)
+					Stats<Types>::barrier_wait(counted);
+				Stats<Types>::barrier_wait(wait);
 
-				OutContainer new_strings;
-		
 				typename Types::size_type new_done_strings_size = done_strings.size();
-				typename Types::size_type new_strings_size = strings.size();
-				for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
+				typename Types::size_type new_strings_size = 0;
+				for (typename Types::size_type i = 0; i < num_of_threads; i++) {
 					new_done_strings_size += results_done[i].size();
 					new_strings_size += results_strings[i].size();
 				}
 				done_strings.reserve(new_done_strings_size);
-				new_strings.reserve(new_strings_size);
-		
-				wait.Wait();
-				for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-					Types::functions::merge(results_strings[i], new_strings);
-					Types::functions::merge(results_done[i], done_strings);
+				if constexpr(!in_place)
+					next.reserve(new_strings_size);
+				for (typename Types::size_type i = 0; i < num_of_threads; i++) {
+					if constexpr(!in_place)
+						merge_forms<merge_derivations, Types>(results_strings[i], next);
+					merge_done<merge_derivations, Types>(results_done[i], done_strings);
 				}
-		
-				strings = std::move(new_strings);
+
+				// the old level's buffer is reused for the next one
+				std::swap(strings, next);
+				next.clear();
 			}
 			// finished, check for done strings in the last batch of generated strings
 			exit = true;
-			go.Wait();
-			for (typename Types::size_type i = 0; i < NUM_OF_THREADS; i++) {
-				threads[i].join();
-			}
+			Stats<Types>::frontier(depth, strings.size());
+			Stats<Types>::barrier_wait(go);
+			pool.wait();
 			for (auto& s: strings) {
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+				typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 				if (pos == Types::string_type::npos) {
-					done_strings.insert(done_strings.end(), std::move(s));
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, std::move(s));
 				}
 			}
-			return done_strings;
 		}
 
 		// single threaded version of gen_dual_containers
-		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_dual_containers_sth(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_dual_containers_sth(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+									DoneContainer& done_strings)
 		{
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
+			LevelArenas level_arenas;
+			FormResourceScope scope;
+			OutContainer strings;
+			typename Types::node_arena arena;
+			for (auto& s: seeds) {
+				insert_form<merge_derivations, Types>(strings, std::move(s));
 			}
-			OutContainer strings = {Types::functions::new_string("S", std::bool_constant<derivation>{})};
-			OutContainer done_strings;
 		
 			for (;depth > 0; depth--) {
+				if constexpr(arena_string_v<typename Types::form_string_type>) {
+					level_arenas.release(depth);
+					scope.use(level_arenas.of(depth));
+				}
+				Stats<Types>::frontier(depth, strings.size());
 				OutContainer new_strings;
 				for (auto& s: strings) {
-					typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 					if (pos == Types::string_type::npos) {
-						done_strings.insert(done_strings.end(), std::move(s));
+						Stats<Types>::finished();
+						insert_done<merge_derivations, Types>(done_strings, std::move(s));
 						continue;
 					}
-					for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
-						new_strings.insert(new_strings.end(), Types::functions::template derivate<low_mem>(s, pos, substitution));
+					Stats<Types>::expanded(depth);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+							continue;
+						insert_form<merge_derivations, Types>(new_strings, derivate<low_mem, Types>(s, pos, substitution, rules, arena));
 					}
 				}
 				strings = std::move(new_strings);
 			}
+			Stats<Types>::frontier(depth, strings.size());
 			for (auto& s: strings) {
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+				typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 				if (pos == Types::string_type::npos) {
-					done_strings.insert(done_strings.end(), std::move(s));
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, std::move(s));
 					continue;
 				}
 			}
-			return done_strings;
+		}
+
+		// external memory version of gen_dual_containers, just for strings.
+		// Each level is kept on disk as runs, sorted (unless repetition) so the k-way merge that reads them back
+		// drops the duplicates. The level is read in batches and each thread writes what it derives to a buffer
+		// that becomes a run when it's full. The done strings are runs too, merged at the end.
+		// The batch and the buffers take about budget bytes
+		template<bool repetition, bool low_mem, typename T, typename Types, typename DoneContainer>
+		void gen_external(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+								WorkerPool& pool, typename Types::size_type num_of_threads, ExternalMemory external,
+								DoneContainer& done_strings)
+		{
+			using string_type = typename Types::string_type;
+			using size_type = typename Types::size_type;
+			constexpr bool dedup = !repetition;
+			const size_type batch_bytes = std::max<size_type>(external.budget / 2, 1);
+			const size_type buffer_bytes = std::max<size_type>(external.budget / 2 / num_of_threads, 1);
+			auto bytes_of = [](const string_type& str) { return str.size() + sizeof(string_type); };
+
+			SpillDirectory directory(external.directory);
+			RunSet level;
+			RunSet done_runs;
+			// writes the strings as a run of set
+			auto spill = [&directory](std::vector<string_type>& strings, RunSet& set) {
+				if (strings.empty())
+					return;
+				if constexpr(dedup)
+					std::sort(strings.begin(), strings.end());
+				auto file = directory.new_file();
+				RunWriter out(file);
+				for (auto& str: strings) {
+					out.add(str);
+				}
+				out.close();
+				set.add(std::move(file));
+				strings.clear();
+			};
+
+			std::vector<string_type> first;
+			for (auto& s: seeds) {
+				first.push_back(Types::functions::materialize(std::move(s)));
+			}
+			spill(first, level);
+
+			struct Buffer {
+				std::vector<string_type> strings;
+				size_type bytes = 0;
+			};
+			std::vector<Buffer> derived(num_of_threads);
+			std::vector<Buffer> done(num_of_threads);
+			std::vector<typename Types::node_arena> arenas(num_of_threads);
+			auto add = [&](Buffer& buffer, string_type&& str, RunSet& set) {
+				buffer.bytes += bytes_of(str);
+				buffer.strings.push_back(std::move(str));
+				if (buffer.bytes >= buffer_bytes) {
+					spill(buffer.strings, set);
+					buffer.bytes = 0;
+				}
+			};
+
+			std::vector<string_type> batch;
+			// the level left, 0 means just collect the done strings
+			size_type steps = depth;
+			auto worker = [&](size_type i) {
+				size_type slice = batch.size() / num_of_threads;
+				size_type start = i * slice;
+				size_type end = i == num_of_threads - 1 ? batch.size() : start + slice;
+				Stats<Types>::frontier(steps, end - start);
+				for (size_type j = start; j < end; j++) {
+					auto s = Types::functions::new_string(std::move(batch[j]), std::false_type{});
+					size_type pos = Types::functions::find_nonterminal(s, rules);
+					if (pos == string_type::npos) {
+						Stats<Types>::finished();
+						add(done[i], Types::functions::materialize(std::move(s)), done_runs);
+						continue;
+					}
+					if (steps == 0)
+						continue;
+					Stats<Types>::expanded(steps);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, steps - 1))
+							continue;
+						add(derived[i], Types::functions::materialize(derivate<low_mem, Types>(s, pos, substitution, rules, arenas[i])), level);
+					}
+				}
+			};
+
+			for (;; steps--) {
+				auto files = reduce_runs(level.take(), dedup, directory);
+				{
+					MergedRuns in(files, dedup);
+					string_type str;
+					bool more = true;
+					while (more) {
+						size_type bytes = 0;
+						while (bytes < batch_bytes && (more = in.next(str))) {
+							bytes += bytes_of(str);
+							batch.push_back(std::move(str));
+						}
+						if (batch.empty())
+							break;
+						if (num_of_threads == 1) {
+							worker(0);
+						}
+						else {
+							pool.run(num_of_threads, Stats<Types>::task(worker));
+							pool.wait();
+						}
+						batch.clear();
+					}
+				}
+				for (auto& file: files) {
+					std::filesystem::remove(file);
+				}
+				for (size_type i = 0; i < num_of_threads; i++) {
+					spill(derived[i].strings, level);
+					derived[i].bytes = 0;
+				}
+				if (steps == 0)
+					break;
+			}
+			for (auto& buffer: done) {
+				spill(buffer.strings, done_runs);
+			}
+
+			std::size_t duplicates = 0;
+			MergedRuns in(reduce_runs(done_runs.take(), dedup, directory, &duplicates), dedup);
+			string_type str;
+			// the merge already dropped the duplicates
+			while (in.next(str)) {
+				insert_new(done_strings, std::move(str));
+			}
+			Stats<Types>::duplicates(duplicates + in.duplicates());
+		}
+
+		// memoized string generator
+		// the seeds are derived, like gen_dual_containers_sth, until there's enough forms to split between the threads.
+		// Then each form is expanded with the yields of its nonterminals from the cache, which are built first,
+		// a step count at a time, each nonterminal's on a thread
+		template<bool repetition, bool low_mem, typename T, typename OutContainer, typename Types, typename DoneContainer>
+		void gen_memoized(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+								WorkerPool& pool, typename Types::size_type num_of_threads, Memoization memo,
+								DoneContainer& done_strings)
+		{
+			using string_type = typename Types::string_type;
+			using size_type = typename Types::size_type;
+			const size_type forms_per_thread = 16;
+			YieldCache<CompiledRules<Types>, size_type, !repetition> cache(rules, memo.cache_budget);
+			auto run = [&](size_type tasks, auto task) {
+				if (num_of_threads == 1) {
+					task(0);
+				}
+				else {
+					pool.run(std::min(tasks, num_of_threads), Stats<Types>::task(task));
+					pool.wait();
+				}
+			};
+
+			OutContainer strings;
+			typename Types::node_arena arena;
+			for (auto& s: seeds) {
+				strings.insert(strings.end(), std::move(s));
+			}
+			for (;depth > 0 && strings.size() < num_of_threads * forms_per_thread; depth--) {
+				Stats<Types>::frontier(depth, strings.size());
+				OutContainer new_strings;
+				for (auto& s: strings) {
+					size_type pos = Types::functions::find_nonterminal(s, rules);
+					if (pos == string_type::npos) {
+						Stats<Types>::finished();
+						insert_done<false, Types>(done_strings, std::move(s));
+						continue;
+					}
+					Stats<Types>::expanded(depth);
+					for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+							continue;
+						new_strings.insert(new_strings.end(), derivate<low_mem, Types>(s, pos, substitution, rules, arena));
+					}
+				}
+				strings = std::move(new_strings);
+			}
+			std::vector<string_type> forms;
+			forms.reserve(strings.size());
+			for (auto& s: strings) {
+				forms.push_back(Types::functions::materialize(std::move(s)));
+			}
+			strings.clear();
+
+			std::string nonterminals;
+			for (auto& rule: rules.source()) {
+				nonterminals.push_back(rule.first);
+			}
+			for (size_type steps = 1; steps <= depth; steps++) {
+				std::atomic<size_type> next = {0};
+				run(static_cast<size_type>(nonterminals.size()), [&](size_type) {
+					for (size_type i; (i = next.fetch_add(1, std::memory_order_relaxed)) < nonterminals.size();) {
+						cache.get(nonterminals[i], steps);
+					}
+				});
+			}
+
+			const LengthBound& bound = rules.length_bound();
+			std::vector<DoneContainer> results_done(num_of_threads, new_done_slot(done_strings));
+			std::atomic<size_type> next = {0};
+			run(static_cast<size_type>(forms.size()), [&](size_type i) {
+				auto emit = [&](const std::string& str) {
+					if (!bound.exact || str.size() == bound.length) {
+						Stats<Types>::finished();
+						insert_done<false, Types>(results_done[i], string_type(str));
+					}
+				};
+				std::string buffer;
+				for (size_type j; (j = next.fetch_add(1, std::memory_order_relaxed)) < forms.size();) {
+					cache.expand(forms[j], depth, false, buffer, emit);
+				}
+			});
+			for (auto& results: results_done) {
+				merge_done<false, Types>(results, done_strings);
+			}
+			Stats<Types>::duplicates(cache.duplicates());
+			Stats<Types>::rebuilt(cache.rebuilds());
 		}
 
 		// single threaded version of gen_controlled_queue
-		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_controlled_queue_sth(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+		template<bool derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_controlled_queue_sth(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+									DoneContainer& done_strings)
 		{
+			constexpr bool merge_derivations = derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
 			if (depth == 0)
-				return OutContainer();
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
+				return;
+			// using the queue container directly (no BlockingCollection necessary), one per level as on
+			// gen_controlled_queue
+			QueueContainer queues[2];
+			QueueContainer* level = &queues[0];
+			QueueContainer* next = &queues[1];
+			typename Types::node_arena arena;
+			for (auto& s: seeds) {
+				level->try_add(std::move(s));
 			}
-			// using the queue container directly (no BlockingCollection necessary)
-			QueueContainer queue;
-			queue.try_add(Types::functions::new_string("S", std::bool_constant<derivation>{}));
-			OutContainer done_strings;
 
-			auto null = Types::functions::new_string("00", std::bool_constant<derivation>{});
-			Types::functions::at(null, 0) = '\0';
 			for (;depth > 0; depth--) {
-				queue.try_add(null);
-				while (true) {
+				Stats<Types>::frontier(depth, level->size());
+				while (level->size() != 0) {
 					T s; 
-					queue.try_take(s);
-					if (Types::functions::size(s) > 0 && Types::functions::at(s, 0) == '\0') {
-						break;
-					}
-					typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+					level->try_take(s);
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 					if (pos == Types::string_type::npos) {
-						done_strings.insert(done_strings.end(), std::move(s));
+						Stats<Types>::finished();
+						insert_done<merge_derivations, Types>(done_strings, Types::functions::materialize(std::move(s)));
 						continue;
 					}
-					for (auto& substitution: rules.at(Types::functions::at(s, pos))) {
-						queue.try_add(Types::functions::template derivate<low_mem>(s, pos, substitution));
+					Stats<Types>::expanded(depth);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+							continue;
+						next->try_add(derivate<low_mem, Types>(s, pos, substitution, rules, arena));
 					}
 
 				}
+				std::swap(level, next);
 			}
 			// get done strings from the last batch
-			while (queue.size() != 0) {
+			Stats<Types>::frontier(depth, level->size());
+			while (level->size() != 0) {
 				T s; 
-				auto status = queue.try_take(s);
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+				level->try_take(s);
+				typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 				if (pos == Types::string_type::npos) {
-					done_strings.insert(done_strings.end(), std::move(s));
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, Types::functions::materialize(std::move(s)));
 				}
 			}
 
-			return done_strings;
 		}
 
 		// single threaded version of gen_free_queue
-		template<bool b_derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types>
-		OutContainer gen_free_queue_sth(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth)
+		template<bool b_derivation, bool low_mem, typename T, typename OutContainer, typename QueueContainer, typename Types, typename DoneContainer>
+		void gen_free_queue_sth(const CompiledRules<Types>& rules, typename Types::size_type depth, std::vector<T> seeds,
+									DoneContainer& done_strings)
 		{
+			constexpr bool merge_derivations = b_derivation && std::is_same_v<QueueContainer, typename Types::auto_t::additive_queue>;
 			if (depth == 0)
-				return OutContainer();
-			typename Types::string_type nonterminals;
-			nonterminals.reserve(rules.size());
-			for (auto& c: rules) {
-				nonterminals.push_back(c.first);
-			}
+				return;
 			QueueContainer queue;
-			queue.try_add(Types::functions::new_string("S", std::bool_constant<b_derivation>{}));
-			OutContainer done_strings;
+			typename Types::node_arena arena;
+			for (auto& s: seeds) {
+				queue.try_add(std::move(s));
+			}
 
 			while (queue.size() != 0) {
 				T s; 
 				queue.try_take(s);
-				typename Types::size_type pos = Types::functions::find_first_of(s, nonterminals);
+				typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
 				if (pos == Types::string_type::npos) {
-					done_strings.insert(done_strings.end(), std::move(s));
+					Stats<Types>::finished();
+					insert_done<merge_derivations, Types>(done_strings, Types::functions::materialize(std::move(s)));
 					continue;
 				}
-				const auto& nonterminal = Types::functions::at(s, pos);
-				const auto* substitution = &(rules.at(nonterminal).front());
-				decltype(s.second) derivations;  //! ugly time saving hack
-				for (auto& derivation: s.second) {
-					if (derivation.size() >= depth)
-						continue;
-					derivations.push_back(std::move(derivation));
-					if constexpr(low_mem)
-						derivations.back().push_back(substitution);
-					else
-						derivations.back().push_back({pos, substitution});
+				// the derivations that reached the depth stop here
+				s.second.erase(std::remove_if(s.second.begin(), s.second.end(),
+												[depth](auto derivation) { return Types::functions::size(derivation) >= depth; }),
+								s.second.end());
+				if (s.second.empty())
+					continue;
+				typename Types::size_type shortest = depth;
+				for (auto derivation: s.second) {
+					shortest = std::min(shortest, Types::functions::size(derivation));
 				}
-				if (derivations.size() == 0) continue;
-				//? Should we do it?
-				//// s.second.clear()
-
-				typename Types::string_type new_string(s.first);
-				new_string.replace(pos, 1, *substitution);
-				T t = {new_string, derivations};
-				queue.try_add(t);
-		
-		
-				for (auto it = ++rules.at(nonterminal).begin(); it != rules.at(nonterminal).end(); it++) {
-					substitution = &(*it);
-					for (auto& derivation: derivations) {
-						if constexpr(low_mem)
-							derivation.back() = substitution;
-						else
-							derivation.back() = {pos, substitution};
-					}
-					typename Types::string_type new_string(s.first, std::false_type{});
-					new_string.replace(pos, 1, *substitution);
-					T t = {new_string, derivations};
-					queue.try_add(t);
+				Stats<Types>::expanded(depth - shortest);
+				const auto& substitutions = rules.at(Types::functions::at(s, pos));
+				for (auto& substitution: substitutions) {
+					if (!Types::functions::fits(s, pos, substitution, rules, depth - shortest - 1))
+						continue;
+					queue.try_add(derivate<low_mem, Types>(s, pos, substitution, rules, arena));
 				}
 			}
 
-			return done_strings;
 		}
 		
 		// setup types, for use on the Types struct, because I
 		// couldn't find a way to use template aliases (with using)
-		template <typename string_type, typename derivation_type, template <typename T> typename sequence_container,
-		template <typename Key> typename set_container, template <typename Key, typename Value> typename map_container,
+		template <typename string_type, typename form_type, typename derivation_type, typename derivation_history, template <typename T> typename sequence_container,
+		template <typename Key> typename set_container, template <typename Key> typename seen_container, template <typename Key, typename Value> typename map_container,
 		typename additive_map_functors>
 		struct SetUpTypes {
 			using derivations_type = sequence_container<derivation_type>;
+			using histories_type = sequence_container<derivation_history>;
 
 			using rules_type = map_container<typename string_type::value_type, sequence_container<string_type>>;
 
 			using repetition_string_container = sequence_container<string_type>;
 			using no_rep_string_container = set_container<string_type>;
 			using derivation_container = map_container<string_type, sequence_container<derivations_type>>;
+			// strings being derived
+			using repetition_form_container = sequence_container<form_type>;
+			using no_rep_form_container = set_container<form_type>;
+			// strings being derived, with the last node of each derivation
+			using history_container = map_container<form_type, histories_type>;
 			
-			using additive_queue = code_machina::AdditiveMapQueueContainer<string_type, sequence_container<derivations_type>,
+			using additive_queue = code_machina::AdditiveMapQueueContainer<form_type, histories_type,
 			typename additive_map_functors::copy, typename additive_map_functors::move, map_container>;
-			using conservative_queue = code_machina::ConservativeMapQueueContainer<string_type, sequence_container<derivations_type>, map_container>;
-			using queue = code_machina::QueueContainer<string_type>;
-			using set_queue = code_machina::SetQueueContainer<string_type, set_container>;
+			using conservative_queue = code_machina::ConservativeMapQueueContainer<form_type, histories_type, map_container>;
+			using queue = code_machina::QueueContainer<form_type>;
+			// the queue's set only tells if a form is queued
+			using set_queue = code_machina::SetQueueContainer<form_type, seen_container>;
 		};
 
-	}
+		// the types used on string generation
+		// RuleId: if void, a derivation step is the substitution and its position (just the substitution on low_memory).
+		// Otherwise, it's the substitution's index on its nonterminal's rules, see CompactTypeDefs
+		// FormString: the string of a form being derived, see ArenaTypeDefs
+		template <bool low_memory, typename RuleId, typename FormString = std::string>
+		struct BasicTypeDefs
+		{
+			template <typename T>
+			using sequence_container = std::vector<T>;
+			template <typename T>
+			using set_container = std::unordered_set<T>;
+			// strings (or forms) that are only checked for having been seen, like the ones handed to a sink or queued
+			template <typename T>
+			using seen_container = set_container<T>;
+			template <typename Key, typename Value>
+			using map_container = std::unordered_map<Key, Value>;
+			template <typename _T1, typename _T2>
+			using pair = std::pair<_T1, _T2>;
+			using size_type = std::size_t;
 
-	// the default types to be used on string generation
-	template <bool low_memory>
-	struct TypeDefs
-	{
-		template <typename T>
-		using sequence_container = std::vector<T>;
-		template <typename T>
-		using set_container = std::unordered_set<T>;
-		template <typename Key, typename Value>
-		using map_container = std::unordered_map<Key, Value>;
-		template <typename _T1, typename _T2>
-		using pair = std::pair<_T1, _T2>;
-		using size_type = std::size_t;
-
-		using string_type = std::string;
-		using derivation_type = std::conditional_t<low_memory, const string_type*, pair<size_type, const string_type*>>; 
-
-		using derivations_type = sequence_container<derivation_type>;
-		//using string_derivation_type = typename map_container<string_type, sequence_container<derivations_type>>::value_type;
-		using string_derivation_type = pair<string_type, sequence_container<derivations_type>>;
-
-		// TODO: use this instead of define
-		const static size_type num_of_threads = 8;
-
-		// these functions are used to be called generically
-		// most mimics string member functions
-		// functions with std::true_type are called when working with derivations
-		// string-derivation types doesn't need the replace() function
-		struct functions {
-			inline static string_type new_string(std::string&& str, std::false_type) { return {str}; }
-			inline static size_type find_first_of(const string_type& this_str, const string_type& str)
-			{
-				return this_str.find_first_of(str);
-			}
-			inline static char& at(string_type& this_str, const size_type pos) { return this_str[pos]; }
-			inline static const char& at(const string_type& this_str, const size_type pos) { return this_str[pos]; }
-			inline static size_type size(const string_type& this_str) { return this_str.size(); }
-			inline static string_type& replace(string_type& this_str, const std::size_t pos, const std::size_t count, const string_type& str)
+			using string_type = std::string;
+			using derivation_type = std::conditional_t<!std::is_void_v<RuleId>, RuleId,
+									std::conditional_t<low_memory, const string_type*, pair<size_type, const string_type*>>>;
+			// the most rules a nonterminal can have
+			static constexpr size_type max_alternatives()
 			{
-				return this_str.replace(pos, count, str);
-			}
-			template <bool low_mem>
-			inline static string_type derivate(const string_type& str, size_type pos, const string_type& substitution)
-			{ 
-				string_type new_string(str);
-				replace(new_string, pos, 1, substitution);
-				return new_string;
+				if constexpr(std::is_void_v<RuleId>)
+					return std::numeric_limits<size_type>::max();
+				else
+					return static_cast<size_type>(std::numeric_limits<RuleId>::max()) + 1;
 			}
 
-			inline static string_derivation_type new_string(std::string&& str, std::true_type) { return {str, {{}}}; }
-			inline static size_type find_first_of(const string_derivation_type& this_str, const string_type& str)
-			{
-				return find_first_of(this_str.first, str);
-			}
-			inline static char& at(string_derivation_type& this_str, const size_type pos) { return at(this_str.first, pos); }
-			inline static const char& at(const string_derivation_type& this_str, const size_type pos) { return at(this_str.first, pos); }
-			inline static size_type size(const string_derivation_type& this_str) { return size(this_str.first); }
-			template <bool low_mem>
-			inline static string_derivation_type derivate(const string_derivation_type& str, size_type pos, const string_type& substitution)
-			{ 
-				auto derivations = str.second;
-				for (auto& derivation: derivations) {
-					if constexpr(low_mem)
-						derivation.push_back(&substitution);
-					else
-						derivation.push_back({pos, &substitution});
-				}
-				// drops const
-				string_type new_string(str.first);
-				new_string.replace(pos, 1, substitution);
-				return {new_string, derivations};
-			}
+			using derivations_type = sequence_container<derivation_type>;
+			//using string_derivation_type = typename map_container<string_type, sequence_container<derivations_type>>::value_type;
+			using string_derivation_type = pair<string_type, sequence_container<derivations_type>>;
+			// a string being derived, with the position of its leftmost nonterminal
+			using form_string_type = FormString;
+			using form_type = detail::SententialForm<form_string_type, size_type>;
+			using cost_type = detail::Cost<size_type>;
+			// a substitution of the compiled rules, see CompiledRules
+			using substitution_type = detail::Substitution<size_type>;
+			// while a string is derived, each derivation is just its last step, pointing to the previous one.
+			// The steps are unwound into a derivations_type when the string is done
+			using derivation_node = detail::DerivationNode<derivation_type, size_type>;
+			using derivation_history = const derivation_node*;
+			using string_history_type = pair<form_type, sequence_container<derivation_history>>;
+			// a string being derived with copies of its derivations
+			using form_derivation_type = pair<form_type, sequence_container<derivations_type>>;
+			using node_arena = detail::NodeArena<derivation_node>;
 
-			template <typename T>
-			inline static void merge(sequence_container<T>& src, sequence_container<T>& dest)
-			{
-				std::move(src.begin(), src.end(), std::back_inserter(dest));
-			}
+			// default number of worker threads, one per hardware thread
+			inline static const size_type num_of_threads = std::max<size_type>(std::thread::hardware_concurrency(), 1);
 
-			template <typename AssociativeContainer>
-			inline static void merge(AssociativeContainer& src, AssociativeContainer& dest)
-			{
-				dest.merge(src);
-			}
-		};
+			// these functions are used to be called generically
+			// most mimics string member functions
+			// functions with std::true_type are called when working with derivations
+			// string-derivation types doesn't need the replace() function
+			struct functions {
+				inline static size_type find_first_of(const string_type& this_str, const string_type& str)
+				{
+					return this_str.find_first_of(str);
+				}
+				// position of the first char from pos on that is a nonterminal on symbols (see CompiledRules), or npos
+				template <typename String, typename Symbols>
+				inline static size_type find_nonterminal(const String& this_str, const Symbols& symbols, size_type pos = 0)
+				{
+					for (; pos < this_str.size(); pos++) {
+						if (symbols.is_nonterminal(this_str[pos]))
+							return pos;
+					}
+					return string_type::npos;
+				}
+				inline static char& at(string_type& this_str, const size_type pos) { return this_str[pos]; }
+				inline static const char& at(const string_type& this_str, const size_type pos) { return this_str[pos]; }
+				inline static size_type size(const string_type& this_str) { return this_str.size(); }
+				inline static const string_type& string_of(const string_type& this_str) { return this_str; }
+				inline static string_type& replace(string_type& this_str, const std::size_t pos, const std::size_t count, const string_type& str)
+				{
+					return this_str.replace(pos, count, str);
+				}
 
+				inline static form_type new_string(std::string&& str, std::false_type)
+				{
+					if constexpr(arena_string_v<form_string_type>) {
+						form_type form{new_form_string<form_string_type>()};
+						form.str.assign(str.data(), str.size());
+						return form;
+					}
+					else {
+						return {form_string_type(std::move(str))};
+					}
+				}
+				template <typename Symbols>
+				inline static size_type find_nonterminal(const form_type& this_str, const Symbols& symbols)
+				{
+					if (this_str.next != form_type::unknown)
+						return this_str.next;
+					return find_nonterminal(this_str.str, symbols);
+				}
+				inline static const char& at(const form_type& this_str, const size_type pos) { return this_str.str[pos]; }
+				inline static size_type size(const form_type& this_str) { return this_str.str.size(); }
+				inline static const form_string_type& string_of(const form_type& this_str) { return this_str.str; }
+				// the Cost of the form after substitution replaces the nonterminal at pos
+				template <typename Symbols>
+				inline static cost_type derived_cost(const form_type& str, size_type pos, const substitution_type& substitution, const Symbols& symbols)
+				{
+					cost_type cost = str.next != form_type::unknown ? str.cost : symbols.cost_of(str.str);
+					// the nonterminal is replaced, not added to
+					if (cost.steps == cost_type::unreachable)
+						return cost;
+					cost.steps -= symbols.cost_of(str.str[pos]).steps;
+					cost.length -= symbols.cost_of(str.str[pos]).length;
+					cost += symbols.cost_of(substitution);
+					return cost;
+				}
+				// if the derivation can still be finished with steps derivations after it (see CompiledRules::fits)
+				template <typename Symbols>
+				inline static bool fits(const form_type& str, size_type pos, const substitution_type& substitution, const Symbols& symbols, size_type steps)
+				{
+					return symbols.fits(derived_cost(str, pos, substitution, symbols), steps);
+				}
+				// substitution replaces the nonterminal at pos, one of symbols' rules (see CompiledRules).
+				// Before pos it's all terminal, so the next nonterminal is searched from pos on.
+				// The bytes allocated for the new string are added to allocated, if it isn't null
+				template <bool low_mem, typename Symbols>
+				inline static form_type derivate(const form_type& str, size_type pos, const substitution_type& substitution, const Symbols& symbols, node_arena&,
+													std::size_t* allocated = nullptr)
+				{ 
+					form_type new_string{derive_string(str.str, pos, substitution.str, symbols, allocated)};
+					new_string.next = next_nonterminal(new_string.str, symbols, pos);
+					new_string.cost = derived_cost(str, pos, substitution, symbols);
+					return new_string;
+				}
 
-		// used with AdditiveMapQueueContainer
-		struct additive_map_functors {
-			struct copy {
-				void operator()(sequence_container<derivations_type>& value, const sequence_container<derivations_type>& new_value)
+				inline static string_history_type new_string(std::string&& str, std::true_type) { return {new_string(std::move(str), std::false_type{}), {nullptr}}; }
+				// strings with their derivations, shared or copied, also as map entries
+				template <typename Form, typename Derivations, typename Symbols>
+				inline static size_type find_nonterminal(const pair<Form, Derivations>& this_str, const Symbols& symbols)
+				{
+					return find_nonterminal(this_str.first, symbols);
+				}
+				template <typename Form, typename Derivations>
+				inline static const char& at(const pair<Form, Derivations>& this_str, const size_type pos) { return at(this_str.first, pos); }
+				template <typename Form, typename Derivations>
+				inline static size_type size(const pair<Form, Derivations>& this_str) { return size(this_str.first); }
+				template <typename Form, typename Derivations>
+				inline static const auto& string_of(const pair<Form, Derivations>& this_str) { return string_of(this_str.first); }
+				template <typename Form, typename Derivations, typename Symbols>
+				inline static bool fits(const pair<Form, Derivations>& str, size_type pos, const substitution_type& substitution, const Symbols& symbols, size_type steps)
+				{
+					return fits(str.first, pos, substitution, symbols, steps);
+				}
+				inline static size_type size(derivation_history derivation) { return derivation_node::length_of(derivation); }
+				template <bool low_mem, typename String, typename Symbols>
+				inline static derivation_type step(const String&, size_type pos, const substitution_type& substitution, const Symbols& symbols)
+				{
+					if constexpr(!std::is_void_v<RuleId>)
+						return static_cast<RuleId>(substitution.alternative);
+					else if constexpr(low_mem)
+						return &symbols.source_of(substitution);
+					else
+						return {pos, &symbols.source_of(substitution)};
+				}
+				template <bool low_mem, typename Symbols>
+				inline static string_history_type derivate(const string_history_type& str, size_type pos, const substitution_type& substitution,
+															const Symbols& symbols, node_arena& arena, std::size_t* allocated = nullptr)
 				{ 
-					std::copy(new_value.begin(), new_value.end(), std::back_inserter(value));
+					derivation_type step = functions::step<low_mem>(str.first.str, pos, substitution, symbols);
+					string_history_type new_string{derivate<low_mem>(str.first, pos, substitution, symbols, arena, allocated), {}};
+					new_string.second.reserve(str.second.size());
+					for (auto derivation: str.second) {
+						new_string.second.push_back(arena.make(step, derivation, allocated));
+					}
+					if (allocated != nullptr)
+						*allocated += new_string.second.capacity() * sizeof(derivation_history);
+					return new_string;
 				}
-			};
-			struct move {
-				void operator()(sequence_container<derivations_type>& value, sequence_container<derivations_type>&& new_value)
+				// copies the derivations, for algorithms that don't keep the strings around
+				template <bool low_mem, typename Symbols>
+				inline static form_derivation_type derivate(const form_derivation_type& str, size_type pos, const substitution_type& substitution,
+																const Symbols& symbols, node_arena& arena, std::size_t* allocated = nullptr)
+				{ 
+					derivation_type step = functions::step<low_mem>(str.first.str, pos, substitution, symbols);
+					auto derivations = str.second;
+					if (allocated != nullptr)
+						*allocated += derivations.capacity() * sizeof(derivations_type);
+					for (auto& derivation: derivations) {
+						// the copy, and the vector it grows to if it's full
+						std::size_t copied = derivation.capacity();
+						derivation.push_back(step);
+						if (allocated != nullptr)
+							*allocated += (copied + (derivation.capacity() != copied ? derivation.capacity() : 0)) * sizeof(derivation_type);
+					}
+					return {derivate<low_mem>(str.first, pos, substitution, symbols, arena, allocated), derivations};
+				}
+
+				// the done string, as it's given to the user. Strings from an arena are copied out of it, ropes flattened
+				inline static string_type done_string(form_string_type&& str)
+				{
+					if constexpr(std::is_same_v<form_string_type, string_type>)
+						return std::move(str);
+					else
+						return flat_string(str);
+				}
+				inline static string_type materialize(string_type str) { return str; }
+				inline static string_derivation_type materialize(string_derivation_type str) { return str; }
+				inline static string_type materialize(form_type str) { return done_string(std::move(str.str)); }
+				inline static string_derivation_type materialize(form_derivation_type str) { return {done_string(std::move(str.first.str)), std::move(str.second)}; }
+				inline static string_derivation_type materialize(string_history_type str)
+				{
+					string_derivation_type done{done_string(std::move(str.first.str)), {}};
+					done.second.reserve(str.second.size());
+					for (auto derivation: str.second) {
+						done.second.push_back(derivation_node::template unwind<derivations_type>(derivation));
+					}
+					return done;
+				}
+
+				template <typename T>
+				inline static void merge(sequence_container<T>& src, sequence_container<T>& dest)
+				{
+					std::move(src.begin(), src.end(), std::back_inserter(dest));
+				}
+
+				template <typename AssociativeContainer>
+				inline static void merge(AssociativeContainer& src, AssociativeContainer& dest)
 				{
-					std::move(new_value.begin(), new_value.end(), std::back_inserter(value));
+					dest.merge(src);
 				}
 			};
+
+
+			// used with AdditiveMapQueueContainer
+			struct additive_map_functors {
+				struct copy {
+					void operator()(sequence_container<derivation_history>& value, const sequence_container<derivation_history>& new_value)
+					{ 
+						std::copy(new_value.begin(), new_value.end(), std::back_inserter(value));
+					}
+				};
+				struct move {
+					void operator()(sequence_container<derivation_history>& value, sequence_container<derivation_history>&& new_value)
+					{
+						std::move(new_value.begin(), new_value.end(), std::back_inserter(value));
+					}
+				};
+			};
+
+			// setup types
+			using auto_t = detail::SetUpTypes<string_type, form_type, derivation_type, derivation_history, sequence_container, set_container, seen_container, map_container, additive_map_functors>;
 		};
+	}
+
+	// the default types to be used on string generation
+	template <bool low_memory>
+	struct TypeDefs : detail::BasicTypeDefs<low_memory, void> {};
 
-		// setup types
-		using auto_t = detail::SetUpTypes<string_type, derivation_type, sequence_container, set_container, map_container, additive_map_functors>;
+	// types that store each derivation step as a RuleId, the index of the substitution on its nonterminal's rules,
+	// instead of pointers. The leftmost derivation fixes the position, so it's recovered with decode_derivation.
+	// RuleId must index the biggest rule list, std::uint8_t is enough for up to 256 rules per nonterminal.
+	// low_memory makes no difference. Usage: cfg_string_generator<..., CompactTypeDefs<std::uint8_t>::type>
+	template <typename RuleId>
+	struct CompactTypeDefs {
+		template <bool low_memory>
+		struct type : detail::BasicTypeDefs<low_memory, RuleId> {};
 	};
 
-	// main function, generates strings based on rules until depth is reached
-	// derivation: enables storing the derivation steps with the string
-	// repetition: if duplicate string (ambiguous grammar) should be stored as well
-	// for just string generation, this means that there won't bve any duplicates
-	// for string and derivation generation, this means that each string will just have one derivation, even if there are multiple
-	// low_memory: just affects if derivation is true. If true, the derivations with the string won't have de position of the nonterminal replaced, just the replacement (removal of redundant information)
-	// fast: if true, use dual_container intead of controlled queue
-	// derivation_fq: just affects if derivation is true. If true, use free_queue instead of controlled_queue
-	// TODO: derivation_fq is for testing purposes. Use the fastest implementation for the derivations
-	// single_threaded: disbales multithreading if true
-	// TypeDefs: struct with the types to be used
-	template <bool derivation = false, bool repetition = false, bool low_memory = false, bool fast = false, bool derivation_fq = false, bool single_threaded = false, template <bool low_mem> typename TypeDefs = TypeDefs>
-	auto cfg_string_generator(const typename TypeDefs<low_memory>::auto_t::rules_type& rules, typename TypeDefs<low_memory>::size_type depth)
+	// types that deduplicate the strings and the strings being derived (without repetition) with a FingerprintSet
+	// instead of unordered_sets. Fingerprint is std::uint64_t or Fingerprint128. Without exact, strings with the
+	// same fingerprint are taken as the same, so a string may be missing (with 64 bits, about n^2 / 2^65 chance
+	// for n strings), and the strings handed to a sink are remembered by fingerprint alone. With exact, the strings are
+	// compared on a fingerprint match. The output container is a FingerprintSet too, iterated in insertion order.
+	// Usage: cfg_string_generator<..., FingerprintTypeDefs<>::type>
+	template <typename Fingerprint = std::uint64_t, bool exact = false>
+	struct FingerprintTypeDefs {
+		template <bool low_memory>
+		struct type : detail::BasicTypeDefs<low_memory, void> {
+			using base = detail::BasicTypeDefs<low_memory, void>;
+
+			template <typename Key>
+			using set_container = detail::FingerprintSet<Key, Fingerprint, exact>;
+			template <typename Key>
+			using seen_container = std::conditional_t<exact, set_container<Key>, detail::FingerprintFilter<Key, Fingerprint>>;
+
+			using auto_t = detail::SetUpTypes<typename base::string_type, typename base::form_type, typename base::derivation_type, typename base::derivation_history,
+									base::template sequence_container, set_container, seen_container, base::template map_container, typename base::additive_map_functors>;
+		};
+	};
+
+	// types that allocate the strings being derived (std::pmr::strings) from per thread bump arenas, one per level,
+	// with the dual containers (fast). A level's strings are freed at once, instead of one by one.
+	// The other algorithms allocate them from the heap. The done strings are copied out of the arenas.
+	// Usage: cfg_string_generator<..., ArenaTypeDefs>
+	template <bool low_memory>
+	struct ArenaTypeDefs : detail::BasicTypeDefs<low_memory, void, std::pmr::string> {};
+
+	// types that keep the strings being derived as Ropes, where a derivation shares the parent's pieces
+	// and copies no chars. The done strings are flattened once. Pays off on long strings and substitutions,
+	// a rope piece costs more than a short string. Usage: cfg_string_generator<..., RopeTypeDefs>
+	template <bool low_memory>
+	struct RopeTypeDefs : detail::BasicTypeDefs<low_memory, void, detail::Rope> {};
+
+	// TypeDefs (any of the above) that also collect a RunStats of the generation, on counters of each thread.
+	// Without it nothing is counted. Usage: cfg_string_generator<..., StatsTypeDefs<TypeDefs>::type>
+	template <template <bool low_memory> typename TypeDefs>
+	struct StatsTypeDefs {
+		template <bool low_memory>
+		struct type : TypeDefs<low_memory> {
+			static constexpr bool collect_stats = true;
+		};
+	};
+
+	// the steps of a derivation from "S" made with CompactTypeDefs, as (position, substitution) pairs
+	template <typename Rules, typename Derivation>
+	auto decode_derivation(const Rules& rules, const Derivation& derivation)
 	{
-		using Types = TypeDefs<low_memory>;
-		if constexpr(derivation) {
-			using Container = typename Types::auto_t::derivation_container;
-			using QueueContainer = std::conditional_t<repetition, typename Types::auto_t::additive_queue, typename Types::auto_t::conservative_queue>;
-			if constexpr(single_threaded) {
-				if constexpr(fast)
-					return detail::gen_dual_containers_sth<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
-				else {
-					if constexpr(derivation_fq)
-						return detail::gen_free_queue_sth<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
-					else 
-						return detail::gen_controlled_queue_sth<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
+		using string_type = typename Rules::mapped_type::value_type;
+		string_type nonterminals;
+		nonterminals.reserve(rules.size());
+		for (auto& c: rules) {
+			nonterminals.push_back(c.first);
+		}
+		std::vector<std::pair<typename string_type::size_type, const string_type*>> steps;
+		steps.reserve(derivation.size());
+		string_type str = "S";
+		for (auto rule_id: derivation) {
+			auto pos = str.find_first_of(nonterminals);
+			const string_type& substitution = rules.at(str[pos])[rule_id];
+			steps.push_back({pos, &substitution});
+			str.replace(pos, 1, substitution);
+		}
+		return steps;
+	}
+
+	// slice index of count of the strings. Running every slice, in any process or machine, and joining
+	// the outputs gives the output of a run without slices. Without repetition, each slice has no duplicates
+	// but a string may be on more than one slice, since different slices can derive the same string.
+	// index must be less than count, cfg_string_generator throws std::invalid_argument otherwise
+	struct Shard {
+		std::size_t index = 0;
+		std::size_t count = 1;
+		// the derivation is expanded until there's this many strings per shard to split
+		static const std::size_t strings_per_shard = 64;
+	};
+
+	// how cfg_string_generator runs, besides the algorithm and the types
+	struct GenerationOptions {
+		// number of worker threads. 0 means TypeDefs::num_of_threads
+		std::size_t num_of_threads = 0;
+		// generate just a slice of the strings, see Shard
+		Shard shard;
+		// generate just the strings up to (or of exactly) a length, see LengthBound
+		LengthBound bound;
+		// keep the strings on disk instead of memory, see ExternalMemory
+		ExternalMemory external;
+		// build the strings from cached yields of the nonterminals, see Memoization
+		Memoization memo;
+		// if not null, gets what the generation did. Just with StatsTypeDefs, see RunStats
+		RunStats* stats = nullptr;
+		// where the worker threads come from, WorkerPool::shared() if null. The threads are kept between calls
+		WorkerPool* pool = nullptr;
+	};
+
+	namespace detail {
+		// the types used by cfg_string_generator for each mode
+		// shared_history: the derivations of the strings being derived share their steps (see DerivationNode).
+		// The nodes live until the generation ends, so the algorithms that keep few strings alive copy them instead
+		template <bool derivation, bool repetition, typename Types, bool shared_history = true>
+		struct GenTypes {
+			// a string being derived
+			using T = std::conditional_t<derivation,
+						std::conditional_t<shared_history, typename Types::string_history_type, typename Types::form_derivation_type>,
+						typename Types::form_type>;
+			// a done string
+			using DoneT = std::conditional_t<derivation, typename Types::string_derivation_type, typename Types::string_type>;
+			using Container = std::conditional_t<derivation, typename Types::auto_t::derivation_container,
+								std::conditional_t<repetition, typename Types::auto_t::repetition_string_container, typename Types::auto_t::no_rep_string_container>>;
+			// strings being derived by the dual containers
+			using WorkContainer = std::conditional_t<derivation, typename Types::auto_t::history_container,
+									std::conditional_t<repetition, typename Types::auto_t::repetition_form_container, typename Types::auto_t::no_rep_form_container>>;
+			using QueueContainer = std::conditional_t<derivation,
+									std::conditional_t<repetition, typename Types::auto_t::additive_queue, typename Types::auto_t::conservative_queue>,
+									std::conditional_t<repetition, typename Types::auto_t::queue, typename Types::auto_t::set_queue>>;
+		};
+
+		// expands the first depth levels from the seeds until there's enough strings to split between the shards,
+		// and keeps just this shard's strings. Each string is weighted by the number of derivations under it
+		// and they're given, heaviest first, to the shard with the least weight so far. Every shard computes
+		// the same split, so they don't need to talk to each other. Strings done before the split belong to
+		// shard 0 and strings that can't be finished are dropped. Returns the depth left for the seeds
+		template <bool derivation, bool low_mem, bool merge_derivations, typename T, typename Types, typename DoneContainer>
+		typename Types::size_type shard_seeds(const CompiledRules<Types>& rules, typename Types::size_type depth,
+												Shard shard, std::vector<T>& seeds, typename Types::node_arena& arena, DoneContainer& done_strings)
+		{
+
+			while (true) {
+				std::vector<T> pending;
+				for (auto& s: seeds) {
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+					if (pos == Types::string_type::npos) {
+						if (shard.index == 0) {
+							Stats<Types>::finished();
+							insert_done<merge_derivations, Types>(done_strings, std::move(s));
+						}
+					}
+					else if (depth > 0) {
+						pending.push_back(std::move(s));
+					}
+				}
+				seeds = std::move(pending);
+				if (depth == 0 || seeds.empty() || seeds.size() >= shard.count * Shard::strings_per_shard)
+					break;
 
+				std::vector<T> new_strings;
+				for (auto& s: seeds) {
+					typename Types::size_type pos = Types::functions::find_nonterminal(s, rules);
+					Stats<Types>::expanded(depth);
+					const auto& substitutions = rules.at(Types::functions::at(s, pos));
+					for (auto& substitution: substitutions) {
+						if (!Types::functions::fits(s, pos, substitution, rules, depth - 1))
+							continue;
+						new_strings.push_back(derivate<low_mem, Types>(s, pos, substitution, rules, arena));
+					}
 				}
+				seeds = std::move(new_strings);
+				depth--;
 			}
-			else {
-				if constexpr(fast)
-					return detail::gen_dual_containers<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
-				else {
-					if constexpr(derivation_fq)
-						return detail::gen_free_queue<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
-					else 
-						return detail::gen_controlled_queue<derivation, low_memory, typename Types::string_derivation_type, Container, QueueContainer, Types>(rules, depth);
+			if (seeds.empty())
+				return depth;
 
-				}
+			DerivationCounter<double, Types> counter(rules.source(), depth, false);
+			std::vector<double> weights(seeds.size());
+			std::vector<typename Types::size_type> order(seeds.size());
+			for (typename Types::size_type i = 0; i < seeds.size(); i++) {
+				weights[i] = counter.completions(Types::functions::string_of(seeds[i]), depth);
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), [&weights](auto a, auto b) { return weights[a] > weights[b]; });
+
+			std::vector<double> loads(shard.count, 0);
+			std::vector<T> own;
+			for (auto i: order) {
+				if (weights[i] == 0)
+					continue;
+				auto lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+				loads[lightest] += weights[i];
+				if (static_cast<std::size_t>(lightest) == shard.index)
+					own.push_back(std::move(seeds[i]));
 			}
+			seeds = std::move(own);
+			return depth;
 		}
-		else {
-			using Container = std::conditional_t<repetition, typename Types::auto_t::repetition_string_container, typename Types::auto_t::no_rep_string_container>;
-			using QueueContainer = std::conditional_t<repetition, typename Types::auto_t::queue, typename Types::auto_t::set_queue>;
+
+		// picks the algorithm and puts the done strings on done_strings
+		template <bool derivation, bool repetition, bool low_memory, bool fast, bool derivation_fq, bool single_threaded, bool work_stealing, bool depth_first, typename Types, typename DoneContainer>
+		void generate(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth,
+						typename Types::size_type num_of_threads, Shard shard, LengthBound bound, ExternalMemory external,
+						Memoization memo, WorkerPool& pool, DoneContainer& done_strings)
+		{
+			constexpr bool shared_history = single_threaded || !(depth_first || work_stealing);
+			using T = typename GenTypes<derivation, repetition, Types, shared_history>::T;
+			using Container = typename GenTypes<derivation, repetition, Types>::WorkContainer;
+			using QueueContainer = typename GenTypes<derivation, repetition, Types>::QueueContainer;
+			if (num_of_threads == 0)
+				num_of_threads = Types::num_of_threads;
+			for (auto& rule: rules) {
+				if (rule.second.size() > Types::max_alternatives())
+					throw std::length_error("cfg_string_generator: a nonterminal has more rules than a derivation step can index");
+			}
+			if (shard.count == 0 || shard.index >= shard.count)
+				throw std::invalid_argument("cfg_string_generator: the shard's index must be less than its count");
+			if (external.budget != 0 && (derivation || !fast))
+				throw std::invalid_argument("cfg_string_generator: the external memory mode is just for fast string generation");
+			if (memo.cache_budget != 0 && (derivation || !fast))
+				throw std::invalid_argument("cfg_string_generator: the memoized expansion is just for fast string generation");
+			if (memo.cache_budget != 0 && external.budget != 0)
+				throw std::invalid_argument("cfg_string_generator: the memoized expansion doesn't keep the strings on disk");
+			constexpr bool merge_derivations = derivation && repetition;
+			const CompiledRules<Types> compiled(rules, bound);
+			// the nodes of the shard's prefix
+			typename Types::node_arena arena;
+			std::vector<T> seeds;
+			auto root = Types::functions::new_string("S", std::bool_constant<derivation>{});
+			// a single derivation without steps
+			if constexpr(derivation && !shared_history)
+				seeds.push_back({std::move(root.first), {{}}});
+			else
+				seeds.push_back(std::move(root));
+			// free queue counts the depth from the derivations, which include the shard's prefix
+			typename Types::size_type full_depth = depth;
+			if (shard.count > 1)
+				depth = shard_seeds<derivation, low_memory, merge_derivations, T, Types>(compiled, depth, shard, seeds, arena, done_strings);
+			if constexpr(fast && !derivation) {
+				if (external.budget != 0) {
+					gen_external<repetition, low_memory, T, Types>(compiled, depth, std::move(seeds), pool, single_threaded ? 1 : num_of_threads, external, done_strings);
+					return;
+				}
+				if (memo.cache_budget != 0) {
+					gen_memoized<repetition, low_memory, T, Container, Types>(compiled, depth, std::move(seeds), pool, single_threaded ? 1 : num_of_threads, memo, done_strings);
+					return;
+				}
+			}
 			if constexpr(single_threaded) {
 				if constexpr(fast)
-					return detail::gen_dual_containers_sth<derivation, low_memory, typename Types::string_type, Container, QueueContainer, Types>(rules, depth);
+					gen_dual_containers_sth<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), done_strings);
+				else if constexpr(derivation && derivation_fq)
+					gen_free_queue_sth<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, full_depth, std::move(seeds), done_strings);
 				else
-					return detail::gen_controlled_queue_sth<derivation, low_memory, typename Types::string_type, Container, QueueContainer, Types>(rules, depth);
+					gen_controlled_queue_sth<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), done_strings);
 			}
 			else {
-				if constexpr(fast)
-					return detail::gen_dual_containers<derivation, low_memory, typename Types::string_type, Container, QueueContainer, Types>(rules, depth);
+				if constexpr(depth_first)
+					gen_depth_first<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), pool, num_of_threads, done_strings);
+				else if constexpr(work_stealing)
+					gen_work_stealing<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), pool, num_of_threads, done_strings);
+				else if constexpr(fast)
+					gen_dual_containers<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), pool, num_of_threads, done_strings);
+				else if constexpr(derivation && derivation_fq)
+					gen_free_queue<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, full_depth, std::move(seeds), pool, num_of_threads, done_strings);
 				else
-					return detail::gen_controlled_queue<derivation, low_memory, typename Types::string_type, Container, QueueContainer, Types>(rules, depth);
+					gen_controlled_queue<derivation, low_memory, T, Container, QueueContainer, Types>(compiled, depth, std::move(seeds), pool, num_of_threads, done_strings);
+			}
+		}
+
+		// picks the algorithm and puts the done strings on done_strings, and what it did on options.stats if it isn't null
+		template <bool derivation, bool repetition, bool low_memory, bool fast, bool derivation_fq, bool single_threaded, bool work_stealing, bool depth_first, typename Types, typename DoneContainer>
+		void generate(const typename Types::auto_t::rules_type& rules, typename Types::size_type depth,
+						const GenerationOptions& options, DoneContainer& done_strings)
+		{
+			auto num_of_threads = static_cast<typename Types::size_type>(options.num_of_threads);
+			RunStats* stats = options.stats;
+			WorkerPool& pool = options.pool != nullptr ? *options.pool : WorkerPool::shared();
+			if (stats != nullptr && !collects_stats_v<Types>)
+				throw std::invalid_argument("cfg_string_generator: the stats are just collected with StatsTypeDefs");
+			if constexpr(collects_stats_v<Types>) {
+				StatsCollector collector(num_of_threads == 0 ? Types::num_of_threads : num_of_threads, depth);
+				{
+					StatsScope scope(&collector, 0);
+					generate<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, Types>(
+						rules, depth, num_of_threads, options.shard, options.bound, options.external, options.memo, pool, done_strings);
+				}
+				if (stats != nullptr)
+					collector.report(*stats);
+			}
+			else {
+				generate<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, Types>(
+					rules, depth, num_of_threads, options.shard, options.bound, options.external, options.memo, pool, done_strings);
 			}
 		}
-	} 
+	}
+
+	// main function, generates strings based on rules until depth is reached
+	// derivation: enables storing the derivation steps with the string
+	// repetition: if duplicate string (ambiguous grammar) should be stored as well
+	// for just string generation, this means that there won't bve any duplicates
+	// for string and derivation generation, this means that each string will just have one derivation, even if there are multiple
+	// low_memory: just affects if derivation is true. If true, the derivations with the string won't have de position of the nonterminal replaced, just the replacement (removal of redundant information)
+	// fast: if true, use dual_container intead of controlled queue
+	// derivation_fq: just affects if derivation is true. If true, use free_queue instead of controlled_queue
+	// TODO: derivation_fq is for testing purposes. Use the fastest implementation for the derivations
+	// single_threaded: disbales multithreading if true
+	// work_stealing: just affects if single_threaded is false. If true, use work_stealing instead of the other algorithms
+	// depth_first: just affects if single_threaded is false. If true, use depth_first instead of the other algorithms
+	// TypeDefs: struct with the types to be used, TypeDefs, CompactTypeDefs<RuleId>::type, FingerprintTypeDefs<...>::type, ArenaTypeDefs or RopeTypeDefs
+	// options: the threads, slice, length bound, memory modes, stats and worker pool, see GenerationOptions
+	template <bool derivation = false, bool repetition = false, bool low_memory = false, bool fast = false, bool derivation_fq = false, bool single_threaded = false, bool work_stealing = false, bool depth_first = false, template <bool low_mem> typename TypeDefs = TypeDefs>
+	auto cfg_string_generator(const typename TypeDefs<low_memory>::auto_t::rules_type& rules, typename TypeDefs<low_memory>::size_type depth,
+							const GenerationOptions& options = {})
+	{
+		using Types = TypeDefs<low_memory>;
+		typename detail::GenTypes<derivation, repetition, Types>::Container done_strings;
+		detail::generate<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, Types>(rules, depth, options, done_strings);
+		return done_strings;
+	}
+
+	// streaming version, the done strings are handed to sink as soon as they're found instead of being returned.
+	// sink is called with a string (or a string and its derivations) as an rvalue, from the worker threads, so it must be thread safe.
+	// Without repetition, each string is handed over once. With repetition and derivation, a string may be handed over
+	// more than once, each time with some of its derivations
+	template <bool derivation = false, bool repetition = false, bool low_memory = false, bool fast = false, bool derivation_fq = false, bool single_threaded = false, bool work_stealing = false, bool depth_first = false, template <bool low_mem> typename TypeDefs = TypeDefs,
+			typename Sink, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Sink>, GenerationOptions>>>
+	void cfg_string_generator(const typename TypeDefs<low_memory>::auto_t::rules_type& rules, typename TypeDefs<low_memory>::size_type depth,
+							Sink&& sink, const GenerationOptions& options = {})
+	{
+		using Types = TypeDefs<low_memory>;
+		using T = typename detail::GenTypes<derivation, repetition, Types>::DoneT;
+		detail::SinkContainer<T, std::remove_reference_t<Sink>, !repetition, Types> done_strings(sink);
+		detail::generate<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, Types>(rules, depth, options, done_strings);
+	}
 }
 #endif // CFG_STRING_GENERATOR_H
@@ -0,0 +1,178 @@
+#ifndef CFG_STRING_GEN_DERIVATION_COUNTER_H
+#define CFG_STRING_GEN_DERIVATION_COUNTER_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <unordered_map>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// counts derivation trees with dynamic programming over (nonterminal, derivation steps, length)
+		// trees[X][n][l] is the number of derivations from X that take exactly n steps and yield l terminals.
+		// A rule X -> a with k nonterminals Y1..Yk has its children's trees convoluted: they take n - 1 steps together.
+		// The partial convolutions of each rule are kept, so each step count is computed once.
+		// Without lengths every string is taken as empty, so the tables are just by steps: O(depth²) per child
+		// instead of O(depth²·max_length²), enough for completions()
+		template <typename Count, typename Types>
+		class DerivationCounter {
+		public:
+			using size_type = typename Types::size_type;
+
+			DerivationCounter(const typename Types::auto_t::rules_type& rules, size_type depth, bool lengths = true) :
+				depth(depth),
+				max_length(0)
+			{
+				// symbol indices
+				for (auto& rule: rules) {
+					index.emplace(rule.first, index.size());
+				}
+				size_type max_terminals = 0;
+				for (auto& rule: rules) {
+					for (auto& substitution: rule.second) {
+						Rule r;
+						r.nonterminal = index.at(rule.first);
+						r.terminals = 0;
+						for (auto c: substitution) {
+							auto it = index.find(c);
+							if (it == index.end())
+								r.terminals += lengths;
+							else
+								r.children.push_back(it->second);
+						}
+						max_terminals = std::max(max_terminals, r.terminals);
+						rules_list.push_back(std::move(r));
+					}
+				}
+				max_length = depth * max_terminals;
+				for (auto& r: rules_list) {
+					r.partial.assign(r.children.size() + 1, Table(table_size(), 0));
+					// the empty product
+					r.partial[0][cell(0, 0)] = 1;
+				}
+				trees.assign(index.size(), Table(table_size(), 0));
+
+				for (size_type n = 1; n <= depth; n++) {
+					for (auto& r: rules_list) {
+						// children's trees that take n - 1 steps together
+						for (size_type j = 1; j <= r.children.size(); j++) {
+							convolute(r.partial[j - 1], trees[r.children[j - 1]], r.partial[j], n - 1);
+						}
+						const Table& children = r.partial.back();
+						for (size_type l = 0; l + r.terminals <= max_length; l++) {
+							add(trees[r.nonterminal][cell(n, l + r.terminals)], children[cell(n - 1, l)]);
+						}
+					}
+				}
+
+				by_steps.assign(index.size(), Table(depth + 1, 0));
+				for (size_type x = 0; x < index.size(); x++) {
+					for (size_type n = 1; n <= depth; n++) {
+						for (size_type l = 0; l <= max_length; l++)
+							add(by_steps[x][n], trees[x][cell(n, l)]);
+					}
+				}
+			}
+
+			// derivations from symbol, by (steps, length). Terminals have none
+			bool has_trees(char symbol) const { return index.count(symbol) != 0; }
+			Count at(char symbol, size_type steps, size_type length) const
+			{
+				return trees[index.at(symbol)][cell(steps, length)];
+			}
+
+			// derivations that turn form into a terminal string in at most budget (<= depth) steps
+			template <typename String>
+			Count completions(const String& form, size_type budget)
+			{
+				// ways[n]: derivations of the nonterminals seen so far, taking n steps together
+				Table ways(budget + 1, 0);
+				ways[0] = 1;
+				for (auto c: form) {
+					auto it = index.find(c);
+					if (it == index.end())
+						continue;
+					Table next(budget + 1, 0);
+					for (size_type n = 0; n <= budget; n++) {
+						if (ways[n] == 0)
+							continue;
+						for (size_type a = 1; n + a <= budget; a++)
+							add(next[n + a], mul(ways[n], by_steps[it->second][a]));
+					}
+					ways = std::move(next);
+				}
+				Count total = 0;
+				for (auto w: ways)
+					add(total, w);
+				return total;
+			}
+
+			size_type get_depth() const { return depth; }
+			size_type get_max_length() const { return max_length; }
+			bool overflowed() const { return overflow; }
+
+			// saturating arithmetic
+			void add(Count& dest, Count value)
+			{
+				if (std::numeric_limits<Count>::max() - dest < value) {
+					dest = std::numeric_limits<Count>::max();
+					overflow = true;
+				}
+				else {
+					dest += value;
+				}
+			}
+			Count mul(Count a, Count b)
+			{
+				if (a != 0 && std::numeric_limits<Count>::max() / a < b) {
+					overflow = true;
+					return std::numeric_limits<Count>::max();
+				}
+				return a * b;
+			}
+
+		private:
+			using Table = std::vector<Count>;
+
+			struct Rule {
+				size_type nonterminal;
+				size_type terminals;
+				std::vector<size_type> children;
+				// partial[j]: trees of the first j children, by (steps, length)
+				std::vector<Table> partial;
+			};
+
+			size_type table_size() const { return (depth + 1) * (max_length + 1); }
+			size_type cell(size_type steps, size_type length) const { return steps * (max_length + 1) + length; }
+
+			// dest[steps] = sum over a of src[steps - a] * child[a], for all lengths
+			void convolute(const Table& src, const Table& child, Table& dest, size_type steps)
+			{
+				for (size_type a = 1; a <= steps; a++) {
+					for (size_type l1 = 0; l1 <= max_length; l1++) {
+						Count left = src[cell(steps - a, l1)];
+						if (left == 0)
+							continue;
+						for (size_type l2 = 0; l1 + l2 <= max_length; l2++) {
+							Count right = child[cell(a, l2)];
+							if (right != 0)
+								add(dest[cell(steps, l1 + l2)], mul(left, right));
+						}
+					}
+				}
+			}
+
+			size_type depth;
+			size_type max_length;
+			bool overflow = false;
+			std::unordered_map<char, size_type> index;
+			std::vector<Rule> rules_list;
+			std::vector<Table> trees;
+			// trees by steps only, any length
+			std::vector<Table> by_steps;
+		};
+	}
+
+}
+#endif // CFG_STRING_GEN_DERIVATION_COUNTER_H
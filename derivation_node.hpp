@@ -0,0 +1,69 @@
+#ifndef CFG_STRING_GEN_DERIVATION_NODE_H
+#define CFG_STRING_GEN_DERIVATION_NODE_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// a derivation step and the steps before it. Derivations that share a prefix share its nodes,
+		// so deriving a string adds one node per derivation instead of copying the whole derivation.
+		// nullptr is the derivation without steps
+		template <typename Step, typename size_type>
+		struct DerivationNode {
+			const DerivationNode* parent;
+			// steps up to this one, including it. 32 bits, so small steps (rule ids) fit in 16 bytes
+			std::uint32_t length;
+			Step step;
+
+			static size_type length_of(const DerivationNode* node) { return node == nullptr ? 0 : node->length; }
+
+			// the steps from the first to the last
+			template <typename Sequence>
+			static Sequence unwind(const DerivationNode* node)
+			{
+				Sequence steps(length_of(node));
+				for (; node != nullptr; node = node->parent) {
+					steps[node->length - 1] = node->step;
+				}
+				return steps;
+			}
+		};
+
+		// bump allocator for derivation nodes. Each thread allocates from its own arena, and
+		// the nodes are freed together with the arena, so it must outlive every string using them
+		template <typename Node>
+		class NodeArena {
+		public:
+			NodeArena() = default;
+			NodeArena(NodeArena&&) = default;
+			NodeArena& operator=(NodeArena&&) = default;
+
+			// adds the bytes of a new block to allocated, if it isn't null
+			template <typename Step>
+			const Node* make(Step&& step, const Node* parent, std::size_t* allocated = nullptr)
+			{
+				if (used == block_size) {
+					blocks.emplace_back(new Node[block_size]);
+					used = 0;
+					if (allocated != nullptr)
+						*allocated += block_size * sizeof(Node);
+				}
+				Node* node = &blocks.back()[used++];
+				node->step = std::forward<Step>(step);
+				node->parent = parent;
+				node->length = static_cast<std::uint32_t>(Node::length_of(parent) + 1);
+				return node;
+			}
+
+		private:
+			static const std::size_t block_size = 4096;
+			std::vector<std::unique_ptr<Node[]>> blocks;
+			std::size_t used = block_size;
+		};
+	}
+}
+#endif // CFG_STRING_GEN_DERIVATION_NODE_H
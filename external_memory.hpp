@@ -0,0 +1,214 @@
+#ifndef CFG_STRING_GEN_EXTERNAL_MEMORY_H
+#define CFG_STRING_GEN_EXTERNAL_MEMORY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// a temporary directory for the runs, removed with everything in it when destroyed
+		class SpillDirectory {
+		public:
+			explicit SpillDirectory(const std::filesystem::path& parent)
+			{
+				std::random_device random;
+				for (int tries = 0; tries < 16; tries++) {
+					path = parent / ("cfg_string_gen_" + std::to_string(random()));
+					if (std::filesystem::create_directories(path))
+						return;
+				}
+				throw std::runtime_error("cfg_string_generator: can't create a spill directory in " + parent.string());
+			}
+			SpillDirectory(const SpillDirectory&) = delete;
+			SpillDirectory& operator=(const SpillDirectory&) = delete;
+			~SpillDirectory()
+			{
+				std::error_code ignored;
+				std::filesystem::remove_all(path, ignored);
+			}
+
+			// a new file name, unique within the directory
+			std::filesystem::path new_file()
+			{
+				return path / (std::to_string(files.fetch_add(1, std::memory_order_relaxed)) + ".run");
+			}
+
+		private:
+			std::filesystem::path path;
+			std::atomic<std::uint64_t> files = {0};
+		};
+
+		// a run is a file of strings, each a 32 bit length and its chars
+		class RunWriter {
+		public:
+			explicit RunWriter(std::filesystem::path file) : file(std::move(file)), out(this->file, std::ios::binary) {}
+
+			void add(const std::string& str)
+			{
+				std::uint32_t length = static_cast<std::uint32_t>(str.size());
+				out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+				out.write(str.data(), static_cast<std::streamsize>(str.size()));
+			}
+			void close()
+			{
+				out.close();
+				if (!out)
+					throw std::runtime_error("cfg_string_generator: can't write the run " + file.string());
+			}
+
+		private:
+			std::filesystem::path file;
+			std::ofstream out;
+		};
+
+		class RunReader {
+		public:
+			explicit RunReader(std::filesystem::path file) : file(std::move(file)), in(this->file, std::ios::binary)
+			{
+				if (!in)
+					throw std::runtime_error("cfg_string_generator: can't read the run " + this->file.string());
+			}
+
+			// false at the end of the run. Throws if it ends in the middle of a string
+			bool next(std::string& str)
+			{
+				std::uint32_t length;
+				if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+					if (in.gcount() != 0)
+						throw std::runtime_error("cfg_string_generator: truncated run " + file.string());
+					return false;
+				}
+				str.resize(length);
+				if (!in.read(&str[0], length))
+					throw std::runtime_error("cfg_string_generator: truncated run " + file.string());
+				return true;
+			}
+
+		private:
+			std::filesystem::path file;
+			std::ifstream in;
+		};
+
+		// the runs of a level (or of the done strings), added by many threads
+		class RunSet {
+		public:
+			void add(std::filesystem::path file)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				files.push_back(std::move(file));
+			}
+			std::vector<std::filesystem::path> take()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return std::move(files);
+			}
+
+		private:
+			std::mutex mutex;
+			std::vector<std::filesystem::path> files;
+		};
+
+		// the strings of sorted runs in order, with a k-way merge. With dedup, each string once.
+		// Unsorted runs (the ones with repetition) are just read one after the other, in a merged order
+		class MergedRuns {
+		public:
+			MergedRuns(const std::vector<std::filesystem::path>& files, bool dedup) : dedup(dedup)
+			{
+				readers.reserve(files.size());
+				for (auto& file: files) {
+					readers.emplace_back(file);
+					std::string str;
+					if (readers.back().next(str))
+						heap.push_back({std::move(str), readers.size() - 1});
+				}
+				std::make_heap(heap.begin(), heap.end(), std::greater<Head>());
+			}
+
+			bool next(std::string& str)
+			{
+				while (!heap.empty()) {
+					std::pop_heap(heap.begin(), heap.end(), std::greater<Head>());
+					Head head = std::move(heap.back());
+					heap.pop_back();
+					std::string following;
+					if (readers[head.run].next(following)) {
+						heap.push_back({std::move(following), head.run});
+						std::push_heap(heap.begin(), heap.end(), std::greater<Head>());
+					}
+					if (dedup && has_last && head.str == last) {
+						dropped++;
+						continue;
+					}
+					if (dedup) {
+						last = head.str;
+						has_last = true;
+					}
+					str = std::move(head.str);
+					return true;
+				}
+				return false;
+			}
+
+			// the strings dropped so far, equal to the one before
+			std::size_t duplicates() const { return dropped; }
+
+		private:
+			struct Head {
+				std::string str;
+				std::size_t run;
+				bool operator>(const Head& other) const { return str > other.str; }
+			};
+
+			bool dedup;
+			bool has_last = false;
+			std::string last;
+			std::size_t dropped = 0;
+			std::vector<RunReader> readers;
+			// min heap of the first string of each run
+			std::vector<Head> heap;
+		};
+
+		// merges the runs max_fan_in at a time, so there's never more than that files open.
+		// Returns the runs left, at most max_fan_in of them. The strings dropped are added to duplicates, if given
+		inline std::vector<std::filesystem::path> reduce_runs(std::vector<std::filesystem::path> files, bool dedup,
+																SpillDirectory& directory, std::size_t* duplicates = nullptr,
+																std::size_t max_fan_in = 64)
+		{
+			while (files.size() > max_fan_in) {
+				std::vector<std::filesystem::path> merged;
+				for (std::size_t first = 0; first < files.size(); first += max_fan_in) {
+					std::vector<std::filesystem::path> group(files.begin() + static_cast<std::ptrdiff_t>(first),
+																files.begin() + static_cast<std::ptrdiff_t>(std::min(first + max_fan_in, files.size())));
+					merged.push_back(directory.new_file());
+					{
+						MergedRuns in(group, dedup);
+						RunWriter out(merged.back());
+						std::string str;
+						while (in.next(str)) {
+							out.add(str);
+						}
+						out.close();
+						if (duplicates != nullptr)
+							*duplicates += in.duplicates();
+					}
+					for (auto& file: group) {
+						std::filesystem::remove(file);
+					}
+				}
+				files = std::move(merged);
+			}
+			return files;
+		}
+	}
+}
+#endif // CFG_STRING_GEN_EXTERNAL_MEMORY_H
@@ -0,0 +1,333 @@
+#ifndef CFG_STRING_GEN_FINGERPRINT_SET_H
+#define CFG_STRING_GEN_FINGERPRINT_SET_H
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	// 128 bit fingerprint, two 64 bit hashes with different seeds
+	struct Fingerprint128 {
+		std::uint64_t low = 0;
+		std::uint64_t high = 0;
+
+		bool operator==(const Fingerprint128& other) const { return low == other.low && high == other.high; }
+		bool operator!=(const Fingerprint128& other) const { return !(*this == other); }
+	};
+
+	namespace detail {
+		// splitmix64 finalizer
+		inline std::uint64_t mix(std::uint64_t h)
+		{
+			h ^= h >> 30;
+			h *= 0xbf58476d1ce4e5b9;
+			h ^= h >> 27;
+			h *= 0x94d049bb133111eb;
+			h ^= h >> 31;
+			return h;
+		}
+
+		// hashes 8 bytes at a time
+		inline std::uint64_t hash_bytes(const char* data, std::size_t size, std::uint64_t seed)
+		{
+			std::uint64_t h = mix(seed ^ size);
+			std::size_t i = 0;
+			for (; i + 8 <= size; i += 8) {
+				std::uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				h = mix(h ^ word);
+			}
+			std::uint64_t tail = 0;
+			std::memcpy(&tail, data + i, size - i);
+			return mix(h ^ tail);
+		}
+
+		// the fingerprint of a string. 0 marks the empty slots, so it's never a fingerprint
+		template <typename Fingerprint>
+		Fingerprint fingerprint_of(const std::string& str)
+		{
+			if constexpr(std::is_same_v<Fingerprint, Fingerprint128>) {
+				Fingerprint128 fp{hash_bytes(str.data(), str.size(), 0x9e3779b97f4a7c15), hash_bytes(str.data(), str.size(), 0xc2b2ae3d27d4eb4f)};
+				if (fp.low == 0)
+					fp.low = 1;
+				return fp;
+			}
+			else {
+				std::uint64_t fp = hash_bytes(str.data(), str.size(), 0x9e3779b97f4a7c15);
+				return fp == 0 ? 1 : fp;
+			}
+		}
+
+		inline std::uint64_t slot_hash(std::uint64_t fp) { return fp; }
+		inline std::uint64_t slot_hash(const Fingerprint128& fp) { return fp.low; }
+		inline bool is_empty(std::uint64_t fp) { return fp == 0; }
+		inline bool is_empty(const Fingerprint128& fp) { return fp.low == 0; }
+
+		// the string a key is fingerprinted by
+		inline const std::string& key_string(const std::string& key) { return key; }
+		template <typename Key>
+		const std::string& key_string(const Key& key) { return key.str; }
+
+		template <typename Fingerprint, typename Value>
+		struct FingerprintSlot {
+			Fingerprint fp = {};
+			Value value = {};
+		};
+		template <typename Fingerprint>
+		struct FingerprintSlot<Fingerprint, void> {
+			Fingerprint fp = {};
+		};
+
+		// open addressing table (linear probing, erasing by shifting back) of fingerprints, each with a value
+		// (void for none). Slots with the same fingerprint are told apart by a predicate on the slot
+		template <typename Fingerprint, typename Value>
+		class FingerprintTable {
+		public:
+			using Slot = FingerprintSlot<Fingerprint, Value>;
+
+			std::size_t size() const { return count; }
+			void clear()
+			{
+				slots.clear();
+				count = 0;
+			}
+			void reserve(std::size_t n)
+			{
+				if (n * 4 > slots.size() * 3)
+					rehash(capacity_for(n));
+			}
+
+			// the slot with fp for which same(slot) is true, or nullptr
+			template <typename Same>
+			const Slot* find(const Fingerprint& fp, Same same) const
+			{
+				if (slots.empty())
+					return nullptr;
+				for (std::size_t i = slot_hash(fp) & mask(); !is_empty(slots[i].fp); i = (i + 1) & mask()) {
+					if (slots[i].fp == fp && same(slots[i]))
+						return &slots[i];
+				}
+				return nullptr;
+			}
+			template <typename Same>
+			Slot* find(const Fingerprint& fp, Same same)
+			{
+				return const_cast<Slot*>(static_cast<const FingerprintTable&>(*this).find(fp, same));
+			}
+			// the slot for fp, a new one (to be filled by the caller) if none is same, and if it's new
+			template <typename Same>
+			std::pair<Slot*, bool> insert(const Fingerprint& fp, Same same)
+			{
+				if ((count + 1) * 4 > slots.size() * 3)
+					rehash(capacity_for(count + 1));
+				std::size_t i = slot_hash(fp) & mask();
+				for (; !is_empty(slots[i].fp); i = (i + 1) & mask()) {
+					if (slots[i].fp == fp && same(slots[i]))
+						return {&slots[i], false};
+				}
+				slots[i].fp = fp;
+				count++;
+				return {&slots[i], true};
+			}
+			void erase(Slot* slot)
+			{
+				std::size_t hole = static_cast<std::size_t>(slot - slots.data());
+				// moves back the slots after the hole that can't be reached without it
+				for (std::size_t i = (hole + 1) & mask(); !is_empty(slots[i].fp); i = (i + 1) & mask()) {
+					std::size_t home = slot_hash(slots[i].fp) & mask();
+					if (((i - home) & mask()) >= ((i - hole) & mask())) {
+						slots[hole] = slots[i];
+						hole = i;
+					}
+				}
+				slots[hole] = Slot{};
+				count--;
+			}
+
+		private:
+			// at most 3/4 full
+			static std::size_t capacity_for(std::size_t n)
+			{
+				std::size_t capacity = 16;
+				while (capacity * 3 < n * 4)
+					capacity <<= 1;
+				return capacity;
+			}
+			std::size_t mask() const { return slots.size() - 1; }
+			void rehash(std::size_t capacity)
+			{
+				std::vector<Slot> old(capacity);
+				old.swap(slots);
+				for (auto& slot: old) {
+					if (is_empty(slot.fp))
+						continue;
+					std::size_t i = slot_hash(slot.fp) & mask();
+					while (!is_empty(slots[i].fp))
+						i = (i + 1) & mask();
+					slots[i] = slot;
+				}
+			}
+
+			std::vector<Slot> slots;
+			std::size_t count = 0;
+		};
+
+		// set of strings (or sentential forms) deduplicated by fingerprint. The keys are kept in a deque
+		// in insertion order, so there's no node per key and the lookups don't chase pointers.
+		// Without exact, keys with the same fingerprint are the same key, and the table has just the fingerprints,
+		// so the set can only be inserted into, merged and iterated. With exact, the table maps each fingerprint to
+		// its key's index, to compare the keys.
+		// Has the part of the unordered_set interface the generator uses
+		template <typename Key, typename Fingerprint, bool exact>
+		class FingerprintSet {
+		public:
+			using value_type = Key;
+			using key_type = Key;
+			using iterator = typename std::deque<Key>::const_iterator;
+			using const_iterator = iterator;
+
+			FingerprintSet() = default;
+			FingerprintSet(const FingerprintSet&) = default;
+			FingerprintSet(FingerprintSet&&) = default;
+			FingerprintSet& operator=(const FingerprintSet&) = default;
+			FingerprintSet& operator=(FingerprintSet&&) = default;
+
+			iterator begin() const { return keys.begin(); }
+			iterator end() const { return keys.end(); }
+			std::size_t size() const { return keys.size(); }
+			bool empty() const { return keys.empty(); }
+			void clear()
+			{
+				keys.clear();
+				table.clear();
+			}
+			void reserve(std::size_t n) { table.reserve(n); }
+
+			iterator find(const Key& key) const
+			{
+				static_assert(exact, "cfg_string_generator: a FingerprintSet without exact can't find its keys");
+				auto slot = table.find(fingerprint_of<Fingerprint>(key_string(key)), same(key));
+				return slot == nullptr ? end() : begin() + slot->value;
+			}
+			std::size_t count(const Key& key) const { return find(key) == end() ? 0 : 1; }
+
+			// without exact, the iterator of a key that was already there is the last key's
+			template <typename K>
+			std::pair<iterator, bool> insert(K&& key)
+			{
+				auto [slot, added] = table.insert(fingerprint_of<Fingerprint>(key_string(key)), same(key));
+				if (added) {
+					if constexpr(exact)
+						slot->value = keys.size();
+					keys.push_back(std::forward<K>(key));
+				}
+				if constexpr(exact)
+					return {begin() + slot->value, added};
+				else
+					return {end() - 1, added};
+			}
+			template <typename K>
+			iterator insert(iterator, K&& key) { return insert(std::forward<K>(key)).first; }
+
+			std::size_t erase(const Key& key)
+			{
+				static_assert(exact, "cfg_string_generator: a FingerprintSet without exact can't erase its keys");
+				auto slot = table.find(fingerprint_of<Fingerprint>(key_string(key)), same(key));
+				if (slot == nullptr)
+					return 0;
+				index_type index = slot->value;
+				table.erase(slot);
+				// the last key takes the erased key's place
+				if (index + 1 != keys.size()) {
+					auto last = table.find(fingerprint_of<Fingerprint>(key_string(keys.back())),
+											[this](const Slot& other) { return other.value + 1 == keys.size(); });
+					last->value = index;
+					keys[index] = std::move(keys.back());
+				}
+				keys.pop_back();
+				return 1;
+			}
+			iterator erase(iterator it)
+			{
+				auto index = it - begin();
+				erase(Key(*it));
+				return begin() + index;
+			}
+
+			// moves the keys that aren't on this set from other, like unordered_set::merge
+			void merge(FingerprintSet& other)
+			{
+				FingerprintSet left;
+				// other's keys are taken from its front, so its memory goes as they're moved
+				other.table = Table();
+				for (; !other.keys.empty(); other.keys.pop_front()) {
+					auto& key = other.keys.front();
+					auto [slot, added] = table.insert(fingerprint_of<Fingerprint>(key_string(key)), same(key));
+					if (added) {
+						if constexpr(exact)
+							slot->value = keys.size();
+						keys.push_back(std::move(key));
+					}
+					else {
+						left.insert(std::move(key));
+					}
+				}
+				other = std::move(left);
+			}
+
+		private:
+			using index_type = std::size_t;
+			using Table = FingerprintTable<Fingerprint, std::conditional_t<exact, index_type, void>>;
+			using Slot = typename Table::Slot;
+
+			// without exact, the fingerprint is enough
+			auto same(const Key& key) const
+			{
+				if constexpr(exact)
+					return [this, &key](const Slot& slot) { return keys[slot.value] == key; };
+				else
+					return [](const Slot&) { return true; };
+			}
+
+			std::deque<Key> keys;
+			Table table;
+		};
+
+		// just the fingerprints of the strings, for sets that are only asked if a string was seen (or is queued).
+		// Has the insert, count and erase of a set, the iterator insert returns isn't usable
+		template <typename Key, typename Fingerprint>
+		class FingerprintFilter {
+		public:
+			std::size_t size() const { return table.size(); }
+			void clear() { table.clear(); }
+			void reserve(std::size_t n) { table.reserve(n); }
+
+			std::pair<const Key*, bool> insert(const Key& key)
+			{
+				return {nullptr, table.insert(fingerprint_of<Fingerprint>(key_string(key)), any).second};
+			}
+			std::size_t count(const Key& key) const { return table.find(fingerprint_of<Fingerprint>(key_string(key)), any) == nullptr ? 0 : 1; }
+			std::size_t erase(const Key& key)
+			{
+				auto slot = table.find(fingerprint_of<Fingerprint>(key_string(key)), any);
+				if (slot == nullptr)
+					return 0;
+				table.erase(slot);
+				return 1;
+			}
+
+		private:
+			using Slot = typename FingerprintTable<Fingerprint, void>::Slot;
+			static bool any(const Slot&) { return true; }
+
+			FingerprintTable<Fingerprint, void> table;
+		};
+	}
+}
+#endif // CFG_STRING_GEN_FINGERPRINT_SET_H
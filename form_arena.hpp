@@ -0,0 +1,65 @@
+#ifndef CFG_STRING_GEN_FORM_ARENA_H
+#define CFG_STRING_GEN_FORM_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <type_traits>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// where this thread allocates the strings of the forms being derived from,
+		// the heap unless an algorithm gives the thread a level arena (see LevelArenas)
+		inline std::pmr::memory_resource*& form_resource()
+		{
+			thread_local std::pmr::memory_resource* resource = std::pmr::new_delete_resource();
+			return resource;
+		}
+
+		// if String allocates from form_resource, like std::pmr::string
+		template <typename String, typename = void>
+		struct is_arena_string : std::false_type {};
+		template <typename String>
+		struct is_arena_string<String, std::void_t<typename String::allocator_type>>
+			: std::is_same<typename String::allocator_type, std::pmr::polymorphic_allocator<typename String::value_type>> {};
+		template <typename String>
+		constexpr bool arena_string_v = is_arena_string<String>::value;
+
+		// an empty String, that allocates from this thread's form_resource if it can
+		template <typename String>
+		String new_form_string()
+		{
+			if constexpr(arena_string_v<String>)
+				return String(typename String::allocator_type(form_resource()));
+			else
+				return String();
+		}
+
+		// bump arenas for the forms of a thread on two levels, the one being read and the one being derived.
+		// A level's forms are freed at once, by releasing its arena when it's used again two levels later
+		class LevelArenas {
+		public:
+			std::pmr::memory_resource* of(std::size_t level) { return &arenas[level % 2]; }
+			// none of the forms of level (or of two levels before or after) may be alive
+			void release(std::size_t level) { arenas[level % 2].release(); }
+
+		private:
+			std::pmr::monotonic_buffer_resource arenas[2];
+		};
+
+		// sets this thread's form_resource, back to the previous one when destroyed
+		class FormResourceScope {
+		public:
+			FormResourceScope() : previous(form_resource()) {}
+			FormResourceScope(const FormResourceScope&) = delete;
+			FormResourceScope& operator=(const FormResourceScope&) = delete;
+			~FormResourceScope() { form_resource() = previous; }
+
+			void use(std::pmr::memory_resource* resource) { form_resource() = resource; }
+
+		private:
+			std::pmr::memory_resource* previous;
+		};
+	}
+}
+#endif // CFG_STRING_GEN_FORM_ARENA_H
@@ -1,40 +1,32 @@
 ﻿#include <iostream>
+#include <cstdio>
 #include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
 #include "cfg_string_generator.hpp"
+#include "cfg_string_count.hpp"
+#include "output_fingerprint.hpp"
+#include "output_writer.hpp"
 
 std::unordered_map<char, std::vector<std::string>> rules;
 size_t depth = 17;
 
-template <typename Container>
-void print_strings(Container& strings)
-{
-    for (auto& s: strings) {
-            std::cout << s;
-            std::cout << std::endl;
-    }
-    std::cout << std::endl;
-}
+constexpr bool get_flag(unsigned flags, std::size_t pos) { return (flags >> pos) & 1; }
 
-template <bool low_mem, typename Container>
-void print_derivations(Container& derivations)
-{
-    for (auto& s: derivations) {
-        std::cout << s.first << " -> " << std::endl;
-        for (auto& derivation: s.second) {
-            for (auto& der: derivation) {
-                if constexpr(low_mem)
-                    std::cout << "(" << *der << "), ";
-                else
-                    std::cout << "(" << der.first << ", " << *der.second << "), ";
-            }
-            std::cout << std::endl;
-        }
-        std::cout << std::endl;
-    }
-    std::cout << std::endl;
-}
+// FLAGS bit 7 stores the derivation steps as rule ids
+// FLAGS bit 8 deduplicates by 64 bit fingerprints, bit 9 checks the strings on fingerprint matches
+// FLAGS bit 10 allocates the strings being derived from level arenas, bit 11 keeps them as ropes
+template <bool low_mem>
+using BaseTypes = std::conditional_t<get_flag(FLAGS, 7), cfg_string_gen::CompactTypeDefs<std::uint8_t>::type<low_mem>,
+                std::conditional_t<get_flag(FLAGS, 8), cfg_string_gen::FingerprintTypeDefs<std::uint64_t, get_flag(FLAGS, 9)>::type<low_mem>,
+                std::conditional_t<get_flag(FLAGS, 10), cfg_string_gen::ArenaTypeDefs<low_mem>,
+                std::conditional_t<get_flag(FLAGS, 11), cfg_string_gen::RopeTypeDefs<low_mem>,
+                cfg_string_gen::TypeDefs<low_mem>>>>>;
 
-constexpr bool get_flag(unsigned flags, std::size_t pos) { return (flags >> pos) & 1; }
+// FLAGS bit 12 collects the run's stats, printed as JSON to stderr
+template <bool low_mem>
+using Types = std::conditional_t<get_flag(FLAGS, 12), cfg_string_gen::StatsTypeDefs<BaseTypes>::type<low_mem>, BaseTypes<low_mem>>;
 
 int main(int argc, char** argv) {
     rules['S'] = {"0A", "1B"};
@@ -51,22 +43,121 @@ int main(int argc, char** argv) {
         std::cout << (get_flag(FLAGS, 2) ? "fast\n" : "");
         std::cout << (get_flag(FLAGS, 3) ? "single_thread\n" : "");
         std::cout << (get_flag(FLAGS, 4) ? "derivation_fq\n" : "");
+        std::cout << (get_flag(FLAGS, 5) ? "work_stealing\n" : "");
+        std::cout << (get_flag(FLAGS, 6) ? "depth_first\n" : "");
+        std::cout << (get_flag(FLAGS, 7) ? "compact\n" : "");
+        std::cout << (get_flag(FLAGS, 8) ? "fingerprint\n" : "");
+        std::cout << (get_flag(FLAGS, 9) ? "exact\n" : "");
+        std::cout << (get_flag(FLAGS, 10) ? "arena\n" : "");
+        std::cout << (get_flag(FLAGS, 11) ? "rope\n" : "");
+        std::cout << (get_flag(FLAGS, 12) ? "stats\n" : "");
         std::cout << FLAGS;
         std::cout << std::endl;
         return 1;
     }
     //const bool OUTPUT_ENABLE = OUTPUT_ENABLE_STR[0] - '0';
     const bool OUTPUT_ENABLE = argv[1][0] == '1' ;
+    // '2' prints the strings as they're generated, without storing them
+    // 'f' prints just the fingerprint of the strings, taken as they're generated (see OutputFingerprint)
+    const bool FINGERPRINT_ENABLE = argv[1][0] == 'f' ;
+    // 'b' streams the strings to stdout in the binary format (see BinaryFormat), read with BinaryOutput
+    const bool BINARY_ENABLE = argv[1][0] == 'b' ;
+    const bool STREAM_ENABLE = argv[1][0] == '2' || FINGERPRINT_ENABLE || BINARY_ENABLE;
+
+    // 'c' just counts the strings
+    if (argv[1][0] == 'c') {
+        auto count = cfg_string_gen::cfg_string_count(rules, depth);
+        std::cout << "total: " << cfg_string_gen::count_to_string(count.total) << (count.overflow ? " (overflow)" : "") << std::endl;
+        for (std::size_t d = 0; d < count.by_depth.size(); d++)
+            std::cout << "depth " << d << ": " << cfg_string_gen::count_to_string(count.by_depth[d]) << std::endl;
+        for (std::size_t l = 0; l < count.by_length.size(); l++)
+            std::cout << "length " << l << ": " << cfg_string_gen::count_to_string(count.by_length[l]) << std::endl;
+        return 0;
+    }
+    cfg_string_gen::GenerationOptions options;
+    // optional thread count, 0 (default) means one per hardware thread
+    if (argc > 2)
+        options.num_of_threads = std::strtoul(argv[2], nullptr, 10);
+    // optional slice, "index count": generates just that slice of the strings
+    if (argc > 4) {
+        options.shard.index = std::strtoul(argv[3], nullptr, 10);
+        options.shard.count = std::strtoul(argv[4], nullptr, 10);
+    }
+    // optional length bound after the slice, "20" for up to 20 characters, "=20" for exactly 20, "-" for none
+    if (argc > 5 && argv[5][0] != '-') {
+        options.bound.exact = argv[5][0] == '=';
+        options.bound.length = std::strtoul(argv[5] + options.bound.exact, nullptr, 10);
+    }
+    // optional memory budget in MiB after the bound, keeps the strings on disk (fast string generation only)
+    if (argc > 6)
+        options.external.budget = std::strtoul(argv[6], nullptr, 10) << 20;
+    // optional yield cache size in MiB after the budget, builds the strings from memoized yields (fast string generation only)
+    if (argc > 7)
+        options.memo.cache_budget = std::strtoul(argv[7], nullptr, 10) << 20;
+    cfg_string_gen::RunStats run_stats;
+    cfg_string_gen::RunStats* stats = get_flag(FLAGS, 12) ? &run_stats : nullptr;
+    options.stats = stats;
 
-    if constexpr (DERIVATION_ENABLE) {
+    if (STREAM_ENABLE) {
+        cfg_string_gen::OutputFingerprinter<decltype(rules)> fingerprinter(rules);
+        cfg_string_gen::TextWriter<decltype(rules)> text(rules, stdout);
+        std::optional<cfg_string_gen::BinaryWriter<decltype(rules)>> binary;
+        if (BINARY_ENABLE)
+            binary.emplace(rules, stdout);
+        auto sink = [&](auto&& s) {
+            if (FINGERPRINT_ENABLE)
+                fingerprinter(s);
+            else if (BINARY_ENABLE)
+                (*binary)(s);
+            else
+                text(s);
+        };
+        if constexpr (DERIVATION_ENABLE)
+            cfg_string_gen::cfg_string_generator<true,
+                                                get_flag(FLAGS, 0),
+                                                get_flag(FLAGS, 3),
+                                                get_flag(FLAGS, 1),
+                                                get_flag(FLAGS, 4),
+                                                get_flag(FLAGS, 2),
+                                                get_flag(FLAGS, 5),
+                                                get_flag(FLAGS, 6),
+                                                Types>(rules, depth, sink, options);
+        else
+            cfg_string_gen::cfg_string_generator<false,
+                                                get_flag(FLAGS, 0),
+                                                false,
+                                                get_flag(FLAGS, 1),
+                                                false,
+                                                get_flag(FLAGS, 2),
+                                                get_flag(FLAGS, 5),
+                                                get_flag(FLAGS, 6),
+                                                Types>(rules, depth, sink, options);
+        if (BINARY_ENABLE) {
+            binary->close();
+        }
+        else {
+            text.close();
+            if (FINGERPRINT_ENABLE)
+                std::cout << fingerprinter.fingerprint().to_string();
+            std::cout << std::endl;
+        }
+    }
+    else if constexpr (DERIVATION_ENABLE) {
         auto derivations = cfg_string_gen::cfg_string_generator<true,
                                                                 get_flag(FLAGS, 0),
                                                                 get_flag(FLAGS, 3),
                                                                 get_flag(FLAGS, 1),
                                                                 get_flag(FLAGS, 4),
-                                                                get_flag(FLAGS, 2)>(rules, depth);
-        if (OUTPUT_ENABLE)
-            print_derivations<get_flag(FLAGS, 3)>(derivations);
+                                                                get_flag(FLAGS, 2),
+                                                                get_flag(FLAGS, 5),
+                                                                get_flag(FLAGS, 6),
+                                                                Types>(rules, depth, options);
+        if (OUTPUT_ENABLE) {
+            cfg_string_gen::TextWriter<decltype(rules)> text(rules, stdout);
+            text.add_all(derivations);
+            text.close();
+            std::cout << std::endl;
+        }
     }
     else {
         auto derivations = cfg_string_gen::cfg_string_generator<false,
@@ -74,9 +165,18 @@ int main(int argc, char** argv) {
                                                                 false,
                                                                 get_flag(FLAGS, 1),
                                                                 false,
-                                                                get_flag(FLAGS, 2)>(rules, depth);
-        if (OUTPUT_ENABLE)
-            print_strings(derivations);
+                                                                get_flag(FLAGS, 2),
+                                                                get_flag(FLAGS, 5),
+                                                                get_flag(FLAGS, 6),
+                                                                Types>(rules, depth, options);
+        if (OUTPUT_ENABLE) {
+            cfg_string_gen::TextWriter<decltype(rules)> text(rules, stdout);
+            text.add_all(derivations);
+            text.close();
+            std::cout << std::endl;
+        }
     }
+    if (stats != nullptr)
+        std::cerr << stats->to_json() << std::endl;
     
 }
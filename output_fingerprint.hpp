@@ -0,0 +1,152 @@
+#ifndef CFG_STRING_GEN_OUTPUT_FINGERPRINT_H
+#define CFG_STRING_GEN_OUTPUT_FINGERPRINT_H
+
+#include "cfg_string_generator.hpp"
+#include "fingerprint_set.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	// order independent fingerprint of what a generation gave: the multiset of its strings or, with derivations,
+	// of its (string, derivation) pairs. It's a sum of the items' hashes, so it doesn't depend on the order the
+	// strings came in, on how the derivations of a string were split between handovers or on how the steps were
+	// stored (low_memory, CompactTypeDefs, ...). Different outputs have the same one with about 2^-64 chance.
+	// The fingerprints of the shards of a generation add up to the fingerprint of the whole one
+	struct OutputFingerprint {
+		// the strings, or the (string, derivation) pairs
+		std::uint64_t count = 0;
+		// the strings' hashes, a string's once per derivation
+		std::uint64_t strings = 0;
+		// the pairs' hashes, 0 without derivations
+		std::uint64_t derivations = 0;
+
+		bool operator==(const OutputFingerprint& other) const
+		{
+			return count == other.count && strings == other.strings && derivations == other.derivations;
+		}
+		bool operator!=(const OutputFingerprint& other) const { return !(*this == other); }
+		// without repetition each string keeps any one of its derivations, so just the strings are compared
+		bool same_strings(const OutputFingerprint& other) const { return count == other.count && strings == other.strings; }
+
+		OutputFingerprint& operator+=(const OutputFingerprint& other)
+		{
+			count += other.count;
+			strings += other.strings;
+			derivations += other.derivations;
+			return *this;
+		}
+
+		// "count:strings:derivations", the hashes in hex
+		std::string to_string() const
+		{
+			char buffer[64];
+			std::snprintf(buffer, sizeof(buffer), ":%016llx:%016llx", static_cast<unsigned long long>(strings), static_cast<unsigned long long>(derivations));
+			return std::to_string(count) + buffer;
+		}
+	};
+
+	namespace detail {
+		inline std::uint64_t hash_string(const std::string& str, std::uint64_t seed = 0x9e3779b97f4a7c15)
+		{
+			return hash_bytes(str.data(), str.size(), seed);
+		}
+
+		// the hash of a derivation, by its substitutions: on a leftmost derivation they fix the positions
+		template <typename Rules, typename Derivation>
+		std::uint64_t hash_derivation(const Rules& rules, const Derivation& derivation)
+		{
+			using Step = typename Derivation::value_type;
+			std::uint64_t h = mix(derivation.size());
+			if constexpr(std::is_integral_v<Step>) {
+				for (auto& step: decode_derivation(rules, derivation))
+					h = hash_string(*step.second, h);
+			}
+			else {
+				for (auto& step: derivation) {
+					if constexpr(std::is_pointer_v<Step>)
+						h = hash_string(*step, h);
+					else
+						h = hash_string(*step.second, h);
+				}
+			}
+			return h;
+		}
+	}
+
+	// a sink for the streaming cfg_string_generator that fingerprints the strings as they're handed over, on the
+	// threads that hand them. Each thread adds to its own slot, without sharing cache lines with the others, and
+	// fingerprint() adds the slots up once the generation is done. Also takes the strings of a returned container,
+	// one by one. rules are just needed to decode the derivations of CompactTypeDefs
+	template <typename Rules>
+	class OutputFingerprinter {
+	public:
+		explicit OutputFingerprinter(const Rules& rules) : rules(&rules), slots(new Slot[num_of_slots]) {}
+
+		template <typename T>
+		void operator()(const T& s)
+		{
+			Slot& slot = slots[thread_slot() % num_of_slots];
+			if constexpr(std::is_same_v<std::decay_t<T>, std::string>) {
+				std::uint64_t h = detail::hash_string(s);
+				slot.count.fetch_add(1, std::memory_order_relaxed);
+				slot.strings.fetch_add(h, std::memory_order_relaxed);
+			}
+			else {
+				std::uint64_t h = detail::hash_string(s.first);
+				for (auto& derivation: s.second) {
+					slot.count.fetch_add(1, std::memory_order_relaxed);
+					slot.strings.fetch_add(h, std::memory_order_relaxed);
+					slot.derivations.fetch_add(detail::mix(h ^ detail::mix(detail::hash_derivation(*rules, derivation))), std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// the strings of a container
+		template <typename Container>
+		void add_all(const Container& strings)
+		{
+			for (auto& s: strings) {
+				(*this)(s);
+			}
+		}
+
+		OutputFingerprint fingerprint() const
+		{
+			OutputFingerprint fingerprint;
+			for (std::size_t i = 0; i < num_of_slots; i++) {
+				fingerprint.count += slots[i].count.load(std::memory_order_relaxed);
+				fingerprint.strings += slots[i].strings.load(std::memory_order_relaxed);
+				fingerprint.derivations += slots[i].derivations.load(std::memory_order_relaxed);
+			}
+			return fingerprint;
+		}
+
+	private:
+		static const std::size_t num_of_slots = 64;
+		// atomic since two threads can share a slot, they're rarely contended
+		struct alignas(64) Slot {
+			std::atomic<std::uint64_t> count = {0};
+			std::atomic<std::uint64_t> strings = {0};
+			std::atomic<std::uint64_t> derivations = {0};
+		};
+
+		// a number for this thread, the threads of the pool get different ones
+		static std::size_t thread_slot()
+		{
+			static std::atomic<std::size_t> next = {0};
+			thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+			return slot;
+		}
+
+		const Rules* rules;
+		std::unique_ptr<Slot[]> slots;
+	};
+}
+#endif // CFG_STRING_GEN_OUTPUT_FINGERPRINT_H
@@ -0,0 +1,716 @@
+#ifndef CFG_STRING_GEN_OUTPUT_WRITER_H
+#define CFG_STRING_GEN_OUTPUT_WRITER_H
+
+#include "cfg_string_generator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// big blocks of output, formatted into by the threads that hand the strings over. Each thread has its own
+		// slot with a buffer, written out whole once it's block_size, so the threads don't wait on each other per
+		// string and the output takes few, big writes. The blocks written are kept on an index.
+		// A failed write stops the output, and flush() throws
+		class BlockOutput {
+		public:
+			struct Block {
+				std::uint64_t offset;
+				std::uint64_t size;
+				std::uint64_t records;
+			};
+
+			// owned: out is closed when destroyed
+			BlockOutput(std::FILE* out, bool owned, std::size_t block_size) :
+				out(out), owned(owned), block_size(block_size), slots(new Slot[num_of_slots]) {}
+			BlockOutput(const BlockOutput&) = delete;
+			BlockOutput& operator=(const BlockOutput&) = delete;
+			~BlockOutput()
+			{
+				if (owned)
+					std::fclose(out);
+			}
+
+			// format(std::string& buffer) appends a record to this thread's buffer
+			template <typename Format>
+			void add(Format&& format)
+			{
+				Slot& slot = slots[thread_slot() % num_of_slots];
+				std::lock_guard<std::mutex> lock(slot.mutex);
+				if (slot.buffer.capacity() < block_size)
+					slot.buffer.reserve(block_size);
+				format(slot.buffer);
+				slot.records++;
+				if (slot.buffer.size() >= block_size)
+					write_block(slot);
+			}
+
+			// writes data out of any block, before the threads add or after they're done
+			void write(const void* data, std::size_t size)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				write_locked(data, size);
+			}
+
+			// writes out the partial blocks, once the threads are done
+			void flush_blocks()
+			{
+				for (std::size_t i = 0; i < num_of_slots; i++) {
+					std::lock_guard<std::mutex> lock(slots[i].mutex);
+					if (slots[i].records != 0)
+						write_block(slots[i]);
+					std::string().swap(slots[i].buffer);
+				}
+			}
+
+			void flush()
+			{
+				if (!failed && std::fflush(out) != 0)
+					failed = true;
+				if (failed)
+					throw std::runtime_error("cfg_string_generator: can't write the output");
+			}
+
+			const std::vector<Block>& blocks() const { return index; }
+			// the bytes written
+			std::uint64_t offset() const { return written; }
+
+		private:
+			static const std::size_t num_of_slots = 64;
+			struct alignas(64) Slot {
+				std::mutex mutex;
+				std::string buffer;
+				std::uint64_t records = 0;
+			};
+
+			// a number for this thread, the threads of the pool get different ones
+			static std::size_t thread_slot()
+			{
+				static std::atomic<std::size_t> next = {0};
+				thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+				return slot;
+			}
+
+			void write_block(Slot& slot)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				index.push_back({written, slot.buffer.size(), slot.records});
+				write_locked(slot.buffer.data(), slot.buffer.size());
+				slot.buffer.clear();
+				slot.records = 0;
+			}
+
+			void write_locked(const void* data, std::size_t size)
+			{
+				if (failed)
+					return;
+				if (std::fwrite(data, 1, size, out) != size)
+					failed = true;
+				written += size;
+			}
+
+			std::FILE* out;
+			bool owned;
+			std::size_t block_size;
+			std::unique_ptr<Slot[]> slots;
+			std::mutex mutex;
+			std::vector<Block> index;
+			std::uint64_t written = 0;
+			bool failed = false;
+		};
+
+		inline std::FILE* open_output(const std::filesystem::path& file)
+		{
+			std::FILE* out = std::fopen(file.string().c_str(), "wb");
+			if (out == nullptr)
+				throw std::runtime_error("cfg_string_generator: can't create " + file.string());
+			return out;
+		}
+
+		template <typename T>
+		void append_value(std::string& buffer, T value)
+		{
+			buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		template <typename T>
+		T read_value(const unsigned char* data)
+		{
+			T value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		// throws if the size bytes at data don't end by end, the end of their block or section
+		inline void check_bytes(const unsigned char* data, std::uint64_t size, const unsigned char* end)
+		{
+			if (data > end || static_cast<std::uint64_t>(end - data) < size)
+				throw std::runtime_error("cfg_string_generator: corrupt binary output, a record or the grammar ends past its section");
+		}
+
+		// a value at data, that must end by end
+		template <typename T>
+		T read_value(const unsigned char* data, const unsigned char* end)
+		{
+			check_bytes(data, sizeof(T), end);
+			return read_value<T>(data);
+		}
+	}
+
+	// the output buffers' default size
+	constexpr std::size_t default_block_size = 1 << 20;
+
+	// writes the strings, or the strings and their derivations, as text, as the executable prints them. A sink for
+	// the streaming cfg_string_generator that can be called from any thread, each formatting on its own buffer,
+	// and takes a returned container with add_all. The strings of a thread (or of add_all) keep their order.
+	// close() writes out what's left on the buffers, the destructor too if it wasn't called.
+	// rules are just needed to decode the derivations of CompactTypeDefs
+	template <typename Rules>
+	class TextWriter {
+	public:
+		// out isn't closed, it may be stdout
+		TextWriter(const Rules& rules, std::FILE* out, std::size_t block_size = default_block_size) :
+			rules(&rules), output(out, false, block_size) {}
+		TextWriter(const Rules& rules, const std::filesystem::path& file, std::size_t block_size = default_block_size) :
+			rules(&rules), output(detail::open_output(file), true, block_size) {}
+		TextWriter(const TextWriter&) = delete;
+		TextWriter& operator=(const TextWriter&) = delete;
+		~TextWriter()
+		{
+			try {
+				close();
+			}
+			catch (const std::runtime_error&) {}
+		}
+
+		template <typename T>
+		void operator()(const T& s)
+		{
+			output.add([&](std::string& buffer) { format(buffer, s); });
+		}
+
+		template <typename Container>
+		void add_all(const Container& strings)
+		{
+			for (auto& s: strings) {
+				(*this)(s);
+			}
+		}
+
+		void close()
+		{
+			if (closed)
+				return;
+			closed = true;
+			output.flush_blocks();
+			output.flush();
+		}
+
+	private:
+		template <typename T>
+		void format(std::string& buffer, const T& s) const
+		{
+			if constexpr(std::is_same_v<std::decay_t<T>, std::string>) {
+				buffer += s;
+				buffer += '\n';
+			}
+			else {
+				buffer += s.first;
+				buffer += " -> \n";
+				for (auto& derivation: s.second) {
+					using Step = typename std::decay_t<decltype(derivation)>::value_type;
+					// compact steps are rule ids, decoded back to (position, substitution)
+					if constexpr(std::is_integral_v<Step>) {
+						for (auto& step: decode_derivation(*rules, derivation))
+							format_step(buffer, step.first, *step.second);
+					}
+					else {
+						for (auto& step: derivation) {
+							if constexpr(std::is_pointer_v<Step>) {
+								buffer += '(';
+								buffer += *step;
+								buffer += "), ";
+							}
+							else {
+								format_step(buffer, step.first, *step.second);
+							}
+						}
+					}
+					buffer += '\n';
+				}
+				buffer += '\n';
+			}
+		}
+
+		template <typename Position, typename String>
+		static void format_step(std::string& buffer, Position pos, const String& substitution)
+		{
+			char digits[24];
+			buffer += '(';
+			buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), pos).ptr);
+			buffer += ", ";
+			buffer += substitution;
+			buffer += "), ";
+		}
+
+		const Rules* rules;
+		detail::BlockOutput output;
+		bool closed = false;
+	};
+
+	// binary output, of BinaryWriter, read by BinaryOutput. All the numbers are in the writer's byte order:
+	//   header: magic "CFGSOUT1", the uint32 0x01020304 (the byte order)
+	//   blocks: records back to back. A record is a string, its uint32 length and its chars, and with derivations
+	//     the uint32 number of them, each its uint32 number of steps and the steps' rule ids, the index of the
+	//     substitution on its nonterminal's rules (see CompactTypeDefs), rule_id_size bytes each
+	//   grammar: the uint32 number of nonterminals, each its char, the uint32 number of rules and the rules as strings
+	//   index: a BinaryBlock per block
+	//   trailer: a BinaryTrailer
+	// The blocks are written as the threads fill them, the rest once the generation is done
+	struct BinaryFormat {
+		static constexpr char magic[8] = {'C', 'F', 'G', 'S', 'O', 'U', 'T', '1'};
+		static constexpr char trailer_magic[8] = {'C', 'F', 'G', 'S', 'I', 'D', 'X', '1'};
+		static constexpr std::uint32_t byte_order = 0x01020304;
+		static constexpr std::size_t header_size = sizeof(magic) + sizeof(byte_order);
+		static constexpr std::uint32_t has_derivations = 1;
+	};
+
+	struct BinaryBlock {
+		std::uint64_t offset;
+		std::uint64_t size;
+		std::uint64_t records;
+	};
+
+	struct BinaryTrailer {
+		std::uint64_t grammar_offset;
+		std::uint64_t index_offset;
+		std::uint64_t blocks;
+		std::uint64_t records;
+		std::uint32_t flags;
+		std::uint32_t rule_id_size;
+		char magic[8];
+	};
+
+	// writes the strings, or the strings and their derivations, in the binary format (see BinaryFormat), as
+	// TextWriter does. The derivation steps are stored as rule ids whatever the TypeDefs, 1 byte each if no
+	// nonterminal has more than 256 rules. close() writes the grammar, the index and the trailer
+	template <typename Rules>
+	class BinaryWriter {
+	public:
+		BinaryWriter(const Rules& rules, std::FILE* out, std::size_t block_size = default_block_size) :
+			rules(&rules), output(out, false, block_size)
+		{
+			start();
+		}
+		BinaryWriter(const Rules& rules, const std::filesystem::path& file, std::size_t block_size = default_block_size) :
+			rules(&rules), output(detail::open_output(file), true, block_size)
+		{
+			start();
+		}
+		BinaryWriter(const BinaryWriter&) = delete;
+		BinaryWriter& operator=(const BinaryWriter&) = delete;
+		~BinaryWriter()
+		{
+			try {
+				close();
+			}
+			catch (const std::runtime_error&) {}
+		}
+
+		template <typename T>
+		void operator()(const T& s)
+		{
+			constexpr bool derivations = !std::is_same_v<std::decay_t<T>, std::string>;
+			if constexpr(derivations)
+				has_derivations.store(true, std::memory_order_relaxed);
+			output.add([&](std::string& buffer) {
+				if constexpr(derivations) {
+					append_string(buffer, s.first);
+					detail::append_value(buffer, static_cast<std::uint32_t>(s.second.size()));
+					for (auto& derivation: s.second) {
+						detail::append_value(buffer, static_cast<std::uint32_t>(derivation.size()));
+						for (auto& step: derivation) {
+							if (rule_id_size == 1)
+								detail::append_value(buffer, static_cast<std::uint8_t>(rule_id(step)));
+							else
+								detail::append_value(buffer, rule_id(step));
+						}
+					}
+				}
+				else {
+					append_string(buffer, s);
+				}
+			});
+		}
+
+		template <typename Container>
+		void add_all(const Container& strings)
+		{
+			for (auto& s: strings) {
+				(*this)(s);
+			}
+		}
+
+		void close()
+		{
+			if (closed)
+				return;
+			closed = true;
+			output.flush_blocks();
+			BinaryTrailer trailer = {};
+			trailer.grammar_offset = output.offset();
+			std::string buffer;
+			detail::append_value(buffer, static_cast<std::uint32_t>(rules->size()));
+			for (auto& rule: *rules) {
+				buffer += rule.first;
+				detail::append_value(buffer, static_cast<std::uint32_t>(rule.second.size()));
+				for (auto& substitution: rule.second) {
+					append_string(buffer, substitution);
+				}
+			}
+			trailer.index_offset = trailer.grammar_offset + buffer.size();
+			for (auto& block: output.blocks()) {
+				detail::append_value(buffer, BinaryBlock{block.offset, block.size, block.records});
+				trailer.records += block.records;
+			}
+			trailer.blocks = output.blocks().size();
+			trailer.flags = has_derivations.load(std::memory_order_relaxed) ? BinaryFormat::has_derivations : 0;
+			trailer.rule_id_size = rule_id_size;
+			std::memcpy(trailer.magic, BinaryFormat::trailer_magic, sizeof(trailer.magic));
+			detail::append_value(buffer, trailer);
+			output.write(buffer.data(), buffer.size());
+			output.flush();
+		}
+
+	private:
+		using string_type = typename Rules::mapped_type::value_type;
+
+		void start()
+		{
+			std::uint32_t most = 0;
+			for (auto& rule: *rules) {
+				for (std::size_t i = 0; i < rule.second.size(); i++) {
+					ids[&rule.second[i]] = static_cast<std::uint32_t>(i);
+				}
+				most = std::max(most, static_cast<std::uint32_t>(rule.second.size()));
+			}
+			rule_id_size = most <= 256 ? 1 : 4;
+			std::string header(BinaryFormat::magic, sizeof(BinaryFormat::magic));
+			detail::append_value(header, BinaryFormat::byte_order);
+			output.write(header.data(), header.size());
+		}
+
+		template <typename Step>
+		std::uint32_t rule_id(const Step& step) const
+		{
+			if constexpr(std::is_integral_v<Step>)
+				return static_cast<std::uint32_t>(step);
+			else if constexpr(std::is_pointer_v<Step>)
+				return ids.at(step);
+			else
+				return ids.at(step.second);
+		}
+
+		template <typename String>
+		static void append_string(std::string& buffer, const String& str)
+		{
+			detail::append_value(buffer, static_cast<std::uint32_t>(str.size()));
+			buffer.append(str.data(), str.size());
+		}
+
+		const Rules* rules;
+		// the rules' ids, by the substitutions' addresses the uncompacted steps point to
+		std::unordered_map<const string_type*, std::uint32_t> ids;
+		std::uint32_t rule_id_size = 1;
+		std::atomic<bool> has_derivations = {false};
+		detail::BlockOutput output;
+		bool closed = false;
+	};
+
+	namespace detail {
+		// a file mapped in memory, or read whole where there's no mmap
+		class MappedFile {
+		public:
+			explicit MappedFile(const std::filesystem::path& file)
+			{
+#if defined(__unix__) || defined(__APPLE__)
+				int fd = ::open(file.c_str(), O_RDONLY);
+				if (fd < 0)
+					throw std::runtime_error("cfg_string_generator: can't open " + file.string());
+				struct stat st;
+				if (::fstat(fd, &st) != 0) {
+					::close(fd);
+					throw std::runtime_error("cfg_string_generator: can't open " + file.string());
+				}
+				length = static_cast<std::size_t>(st.st_size);
+				if (length != 0) {
+					void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+					::close(fd);
+					if (mapped == MAP_FAILED)
+						throw std::runtime_error("cfg_string_generator: can't map " + file.string());
+					mapping = static_cast<const unsigned char*>(mapped);
+				}
+				else {
+					::close(fd);
+				}
+#else
+				std::ifstream in(file, std::ios::binary);
+				if (!in)
+					throw std::runtime_error("cfg_string_generator: can't open " + file.string());
+				contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+				mapping = reinterpret_cast<const unsigned char*>(contents.data());
+				length = contents.size();
+#endif
+			}
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile()
+			{
+#if defined(__unix__) || defined(__APPLE__)
+				if (mapping != nullptr)
+					::munmap(const_cast<unsigned char*>(mapping), length);
+#endif
+			}
+
+			const unsigned char* data() const { return mapping; }
+			std::size_t size() const { return length; }
+
+		private:
+			const unsigned char* mapping = nullptr;
+			std::size_t length = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+			std::string contents;
+#endif
+		};
+	}
+
+	// reads a file of BinaryWriter, mapped in memory, without copying: the records are views into the mapping,
+	// valid while the BinaryOutput lives. The records can be read in order, or by block, a block at a time
+	// per thread. A derivation's steps are rule ids, decode_derivation(rules(), derivation.steps()) gives them
+	// as (position, substitution). A corrupt or truncated file throws std::runtime_error, when it's opened if its
+	// index or grammar are wrong, or when a record that doesn't end by its block's end is read
+	class BinaryOutput {
+	public:
+		using Rules = std::unordered_map<char, std::vector<std::string>>;
+
+		class Derivation {
+		public:
+			// end: the end of its record's block
+			Derivation(const unsigned char* data, std::uint32_t rule_id_size, const unsigned char* end) :
+				data(data), rule_id_size(rule_id_size), steps_size(detail::read_value<std::uint32_t>(data, end))
+			{
+				detail::check_bytes(data, bytes(), end);
+			}
+
+			std::size_t size() const { return steps_size; }
+			std::uint32_t operator[](std::size_t i) const
+			{
+				const unsigned char* step = data + sizeof(std::uint32_t) + i * rule_id_size;
+				return rule_id_size == 1 ? *step : detail::read_value<std::uint32_t>(step);
+			}
+			std::vector<std::uint32_t> steps() const
+			{
+				std::vector<std::uint32_t> steps(size());
+				for (std::size_t i = 0; i < steps.size(); i++) {
+					steps[i] = (*this)[i];
+				}
+				return steps;
+			}
+			// the bytes it takes
+			std::uint64_t bytes() const { return sizeof(std::uint32_t) + std::uint64_t(steps_size) * rule_id_size; }
+
+		private:
+			const unsigned char* data;
+			std::uint32_t rule_id_size;
+			std::uint32_t steps_size;
+		};
+
+		class Record {
+		public:
+			// end: the end of its block
+			Record(const unsigned char* data, const unsigned char* end, const BinaryTrailer* trailer) : data(data), end(end), trailer(trailer) {}
+
+			std::string_view string() const
+			{
+				std::uint32_t length = detail::read_value<std::uint32_t>(data, end);
+				detail::check_bytes(data + sizeof(length), length, end);
+				return {reinterpret_cast<const char*>(data + sizeof(length)), length};
+			}
+			// empty without derivations
+			std::vector<Derivation> derivations() const
+			{
+				std::vector<Derivation> derivations;
+				if (!(trailer->flags & BinaryFormat::has_derivations))
+					return derivations;
+				const unsigned char* p = data + sizeof(std::uint32_t) + string().size();
+				std::uint32_t count = detail::read_value<std::uint32_t>(p, end);
+				p += sizeof(std::uint32_t);
+				for (std::uint32_t i = 0; i < count; i++) {
+					derivations.emplace_back(p, trailer->rule_id_size, end);
+					p += derivations.back().bytes();
+				}
+				return derivations;
+			}
+			// the bytes it takes
+			std::size_t bytes() const
+			{
+				std::size_t bytes = sizeof(std::uint32_t) + string().size();
+				if (!(trailer->flags & BinaryFormat::has_derivations))
+					return bytes;
+				std::uint32_t count = detail::read_value<std::uint32_t>(data + bytes, end);
+				bytes += sizeof(std::uint32_t);
+				for (std::uint32_t i = 0; i < count; i++) {
+					bytes += static_cast<std::size_t>(Derivation(data + bytes, trailer->rule_id_size, end).bytes());
+				}
+				return bytes;
+			}
+
+		private:
+			const unsigned char* data;
+			const unsigned char* end;
+			const BinaryTrailer* trailer;
+		};
+
+		class iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Record;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = Record;
+
+			iterator(const unsigned char* data, const unsigned char* end, const BinaryTrailer* trailer) : data(data), end(end), trailer(trailer) {}
+
+			Record operator*() const { return {data, end, trailer}; }
+			iterator& operator++()
+			{
+				data += Record(data, end, trailer).bytes();
+				return *this;
+			}
+			iterator operator++(int)
+			{
+				iterator previous = *this;
+				++*this;
+				return previous;
+			}
+			bool operator==(const iterator& other) const { return data == other.data; }
+			bool operator!=(const iterator& other) const { return data != other.data; }
+
+		private:
+			const unsigned char* data;
+			const unsigned char* end;
+			const BinaryTrailer* trailer;
+		};
+
+		// records, a block's or all of them
+		class Range {
+		public:
+			Range(iterator first, iterator last, std::uint64_t records) : first(first), last(last), records(records) {}
+			iterator begin() const { return first; }
+			iterator end() const { return last; }
+			std::uint64_t size() const { return records; }
+
+		private:
+			iterator first, last;
+			std::uint64_t records;
+		};
+
+		explicit BinaryOutput(const std::filesystem::path& file) : mapped(file)
+		{
+			const unsigned char* data = mapped.data();
+			if (mapped.size() < BinaryFormat::header_size + sizeof(BinaryTrailer) ||
+				std::memcmp(data, BinaryFormat::magic, sizeof(BinaryFormat::magic)) != 0)
+				throw std::runtime_error("cfg_string_generator: not a binary output, or truncated: " + file.string());
+			if (detail::read_value<std::uint32_t>(data + sizeof(BinaryFormat::magic)) != BinaryFormat::byte_order)
+				throw std::runtime_error("cfg_string_generator: binary output of another byte order: " + file.string());
+			trailer = detail::read_value<BinaryTrailer>(data + mapped.size() - sizeof(BinaryTrailer));
+			// the index is between index_offset and the trailer
+			const std::uint64_t index_end = mapped.size() - sizeof(BinaryTrailer);
+			if (std::memcmp(trailer.magic, BinaryFormat::trailer_magic, sizeof(trailer.magic)) != 0 ||
+				trailer.grammar_offset < BinaryFormat::header_size || trailer.index_offset < trailer.grammar_offset ||
+				trailer.index_offset > index_end || trailer.blocks > index_end / sizeof(BinaryBlock) ||
+				index_end - trailer.index_offset != trailer.blocks * sizeof(BinaryBlock) ||
+				(trailer.rule_id_size != 1 && trailer.rule_id_size != 4))
+				throw std::runtime_error("cfg_string_generator: binary output without its index, or truncated: " + file.string());
+			index.resize(static_cast<std::size_t>(trailer.blocks));
+			for (std::size_t i = 0; i < index.size(); i++) {
+				index[i] = detail::read_value<BinaryBlock>(data + trailer.index_offset + i * sizeof(BinaryBlock));
+				if (index[i].offset < BinaryFormat::header_size || index[i].offset > trailer.grammar_offset ||
+					index[i].size > trailer.grammar_offset - index[i].offset)
+					throw std::runtime_error("cfg_string_generator: binary output with a bad index: " + file.string());
+			}
+			const unsigned char* p = data + trailer.grammar_offset;
+			const unsigned char* grammar_end = data + trailer.index_offset;
+			auto read_string = [&p, grammar_end]() {
+				std::uint32_t length = detail::read_value<std::uint32_t>(p, grammar_end);
+				detail::check_bytes(p + sizeof(length), length, grammar_end);
+				std::string str(reinterpret_cast<const char*>(p + sizeof(length)), length);
+				p += sizeof(length) + length;
+				return str;
+			};
+			std::uint32_t nonterminals = detail::read_value<std::uint32_t>(p, grammar_end);
+			p += sizeof(nonterminals);
+			for (std::uint32_t i = 0; i < nonterminals; i++) {
+				char nonterminal = detail::read_value<char>(p++, grammar_end);
+				std::uint32_t count = detail::read_value<std::uint32_t>(p, grammar_end);
+				p += sizeof(count);
+				auto& substitutions = grammar[nonterminal];
+				for (std::uint32_t j = 0; j < count; j++) {
+					substitutions.push_back(read_string());
+				}
+			}
+		}
+
+		bool has_derivations() const { return trailer.flags & BinaryFormat::has_derivations; }
+		// the grammar that generated the strings
+		const Rules& rules() const { return grammar; }
+		// the records
+		std::uint64_t size() const { return trailer.records; }
+
+		iterator begin() const { return {mapped.data() + BinaryFormat::header_size, records_end(), &trailer}; }
+		iterator end() const { return {records_end(), records_end(), &trailer}; }
+		Range records() const { return {begin(), end(), size()}; }
+
+		std::size_t num_of_blocks() const { return index.size(); }
+		Range block(std::size_t i) const
+		{
+			const unsigned char* first = mapped.data() + index.at(i).offset;
+			const unsigned char* last = first + index[i].size;
+			return {{first, last, &trailer}, {last, last, &trailer}, index[i].records};
+		}
+
+	private:
+		const unsigned char* records_end() const { return mapped.data() + trailer.grammar_offset; }
+
+		detail::MappedFile mapped;
+		BinaryTrailer trailer;
+		std::vector<BinaryBlock> index;
+		Rules grammar;
+	};
+}
+#endif // CFG_STRING_GEN_OUTPUT_WRITER_H
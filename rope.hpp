@@ -0,0 +1,298 @@
+#ifndef CFG_STRING_GEN_ROPE_H
+#define CFG_STRING_GEN_ROPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// a string being derived as a persistent list of pieces, each a view of a substitution (or of the string
+		// it was made from), so derivating it copies no chars. The pieces before the leftmost nonterminal are
+		// the prefix, kept from the last one, and the ones from it on are the suffix. A derivation replaces the
+		// suffix's first char and moves the terminals that come before the next nonterminal to the prefix, so its
+		// children share the parent's prefix and the suffix after the nonterminal.
+		// The substitutions must outlive the ropes
+		class Rope {
+		public:
+			using value_type = char;
+			using size_type = std::size_t;
+			static constexpr size_type npos = std::string::npos;
+
+			Rope() = default;
+			Rope(const Rope&) = default;
+			Rope& operator=(const Rope&) = default;
+			Rope(Rope&& other) noexcept { *this = std::move(other); }
+			Rope& operator=(Rope&& other) noexcept
+			{
+				prefix = std::move(other.prefix);
+				suffix = std::move(other.suffix);
+				prefix_length = std::exchange(other.prefix_length, 0);
+				length = std::exchange(other.length, 0);
+				return *this;
+			}
+			explicit Rope(std::string str)
+			{
+				if (str.empty())
+					return;
+				auto owner = std::make_shared<std::string>(std::move(str));
+				length = owner->size();
+				suffix = make_node(*owner, nullptr, owner);
+			}
+
+			size_type size() const { return length; }
+			bool empty() const { return length == 0; }
+
+			const char& operator[](size_type i) const
+			{
+				if (i >= prefix_length) {
+					i -= prefix_length;
+					const Node* node = suffix.get();
+					for (; i >= node->text.size(); node = node->next.get()) {
+						i -= node->text.size();
+					}
+					return node->text[i];
+				}
+				// the prefix is kept from its last piece
+				size_type end = prefix_length;
+				const Node* node = prefix.get();
+				for (; i < end - node->text.size(); node = node->next.get()) {
+					end -= node->text.size();
+				}
+				return node->text[i - (end - node->text.size())];
+			}
+
+			// the position of the leftmost nonterminal, npos if there's none
+			size_type nonterminal() const { return suffix ? prefix_length : npos; }
+
+			// the rope with substitution replacing the nonterminal at pos, that must be the leftmost one.
+			// Adds the bytes of the nodes made to allocated, if it isn't null
+			template <typename Symbols>
+			Rope derive(size_type pos, std::string_view substitution, const Symbols& symbols, std::size_t* allocated = nullptr) const
+			{
+				Rope child;
+				// the nodes made
+				size_type made = 0;
+				child.prefix = prefix;
+				child.prefix_length = prefix_length;
+				child.length = length - 1 + substitution.size();
+				// a rope made from a string doesn't know its nonterminal yet, the terminals before it go to the prefix
+				const Node* head = suffix.get();
+				size_type offset = pos - prefix_length;
+				for (; offset >= head->text.size(); head = head->next.get()) {
+					child.push_prefix(head->text, head->owner, made);
+					offset -= head->text.size();
+				}
+				if (offset > 0)
+					child.push_prefix(head->text.substr(0, offset), head->owner, made);
+				// the pieces after the nonterminal
+				Link rest = head->next;
+				if (offset + 1 < head->text.size())
+					rest = make_node(head->text.substr(offset + 1), std::move(rest), head->owner, made);
+
+				// moves the terminals to the prefix until a nonterminal is found
+				std::string_view piece = substitution;
+				const Link* node = nullptr;
+				while (true) {
+					size_type k = 0;
+					while (k < piece.size() && !symbols.is_nonterminal(piece[k]))
+						k++;
+					if (k < piece.size()) {
+						if (k > 0)
+							child.push_prefix(piece.substr(0, k), owner_of(node), made);
+						// a piece that starts with it is shared
+						if (k == 0 && node != nullptr)
+							child.suffix = *node;
+						else
+							child.suffix = make_node(piece.substr(k), node != nullptr ? (*node)->next : std::move(rest), owner_of(node), made);
+						break;
+					}
+					if (!piece.empty())
+						child.push_prefix(piece, owner_of(node), made);
+					if (node == nullptr)
+						node = &rest;
+					else
+						node = &(*node)->next;
+					if (!*node)
+						break;
+					piece = (*node)->text;
+				}
+				if (allocated != nullptr)
+					*allocated += made * node_bytes();
+				return child;
+			}
+
+			// the chars, in order
+			std::string str() const
+			{
+				std::string flat(length, '\0');
+				// the prefix is kept from its last piece
+				size_type end = prefix_length;
+				for (const Node* node = prefix.get(); node != nullptr; node = node->next.get()) {
+					end -= node->text.size();
+					node->text.copy(&flat[end], node->text.size());
+				}
+				end = prefix_length;
+				for (const Node* node = suffix.get(); node != nullptr; node = node->next.get()) {
+					node->text.copy(&flat[end], node->text.size());
+					end += node->text.size();
+				}
+				return flat;
+			}
+
+			// iterates over a copy of the chars, for the uses that aren't derivations
+			class const_iterator {
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = char;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const char*;
+				using reference = const char&;
+
+				const_iterator() = default;
+				const_iterator(std::shared_ptr<const std::string> flat, size_type i) : flat(std::move(flat)), i(i) {}
+
+				reference operator*() const { return (*flat)[i]; }
+				const_iterator& operator++() { i++; return *this; }
+				const_iterator operator++(int) { auto old = *this; i++; return old; }
+				bool operator==(const const_iterator& other) const { return i == other.i; }
+				bool operator!=(const const_iterator& other) const { return i != other.i; }
+
+			private:
+				std::shared_ptr<const std::string> flat;
+				size_type i = 0;
+			};
+			const_iterator begin() const { return {std::make_shared<const std::string>(str()), 0}; }
+			const_iterator end() const { return {nullptr, length}; }
+
+			// a polynomial hash of the chars, taken piece by piece
+			std::size_t hash() const
+			{
+				std::uint64_t h = 0;
+				for (const Node* node = suffix.get(); node != nullptr; node = node->next.get()) {
+					h = hash_of(node->text, h).first;
+				}
+				// the prefix pieces come before, times base to the power of the chars after them
+				std::uint64_t after = power_of(length - prefix_length);
+				for (const Node* node = prefix.get(); node != nullptr; node = node->next.get()) {
+					auto [piece, power] = hash_of(node->text, 0);
+					h += piece * after;
+					after *= power;
+				}
+				return static_cast<std::size_t>(h);
+			}
+			bool operator==(const Rope& other) const
+			{
+				return length == other.length && hash() == other.hash() && str() == other.str();
+			}
+			bool operator!=(const Rope& other) const { return !(*this == other); }
+
+		private:
+			using Owner = std::shared_ptr<const std::string>;
+			struct Node {
+				std::string_view text;
+				std::shared_ptr<const Node> next;
+				// the string text is a view of, if it isn't a substitution (these outlive the ropes)
+				Owner owner;
+			};
+			using Link = std::shared_ptr<const Node>;
+			// std::allocator, that keeps the size it allocates on probed_size. Stateless, so a shared_ptr
+			// allocated with it is laid out like one from make_shared
+			template <typename T>
+			struct SizeProbe : std::allocator<T> {
+				template <typename U>
+				struct rebind { using other = SizeProbe<U>; };
+
+				SizeProbe() = default;
+				template <typename U>
+				SizeProbe(const SizeProbe<U>&) {}
+				T* allocate(std::size_t n)
+				{
+					probed_size = n * sizeof(T);
+					return std::allocator<T>::allocate(n);
+				}
+			};
+			inline static std::size_t probed_size = 0;
+
+			static Owner owner_of(const Link* node) { return node != nullptr ? (*node)->owner : nullptr; }
+
+			static constexpr std::uint64_t base = 0x100000001b3;
+			// the hash of text after the chars hashed to h, and base to the power of its length
+			static std::pair<std::uint64_t, std::uint64_t> hash_of(std::string_view text, std::uint64_t h)
+			{
+				std::uint64_t power = 1;
+				for (auto c: text) {
+					h = h * base + static_cast<unsigned char>(c) + 1;
+					power *= base;
+				}
+				return {h, power};
+			}
+			static std::uint64_t power_of(size_type n)
+			{
+				std::uint64_t p = 1;
+				for (size_type i = 0; i < n; i++) {
+					p *= base;
+				}
+				return p;
+			}
+
+			// the bytes make_node allocates, the node with its shared_ptr counts
+			static std::size_t node_bytes()
+			{
+				static const std::size_t bytes = [] {
+					std::allocate_shared<const Node>(SizeProbe<Node>(), Node{});
+					return probed_size;
+				}();
+				return bytes;
+			}
+			static Link make_node(std::string_view text, Link next, Owner owner)
+			{
+				return std::make_shared<const Node>(Node{text, std::move(next), std::move(owner)});
+			}
+			static Link make_node(std::string_view text, Link next, Owner owner, size_type& made)
+			{
+				made++;
+				return make_node(text, std::move(next), std::move(owner));
+			}
+			void push_prefix(std::string_view text, Owner owner, size_type& made)
+			{
+				prefix = make_node(text, std::move(prefix), std::move(owner), made);
+				prefix_length += text.size();
+			}
+
+			Link prefix;
+			Link suffix;
+			size_type prefix_length = 0;
+			size_type length = 0;
+		};
+
+		// the rope with substitution replacing the nonterminal at pos, see derive_string
+		template <typename Symbols>
+		Rope derive_string(const Rope& str, std::size_t pos, std::string_view substitution, const Symbols& symbols, std::size_t* allocated = nullptr)
+		{
+			return str.derive(pos, substitution, symbols, allocated);
+		}
+
+		template <typename Symbols>
+		std::size_t next_nonterminal(const Rope& str, const Symbols&, std::size_t)
+		{
+			return str.nonterminal();
+		}
+
+		inline std::string flat_string(const Rope& str) { return str.str(); }
+	}
+}
+
+namespace std
+{
+	template <>
+	struct hash<cfg_string_gen::detail::Rope> {
+		std::size_t operator()(const cfg_string_gen::detail::Rope& rope) const { return rope.hash(); }
+	};
+}
+#endif // CFG_STRING_GEN_ROPE_H
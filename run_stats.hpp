@@ -0,0 +1,305 @@
+#ifndef CFG_STRING_GEN_RUN_STATS_H
+#define CFG_STRING_GEN_RUN_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	// what a generation did, collected when its TypeDefs are StatsTypeDefs<...>::type.
+	// The levels are the derivation steps from "S", level 0 is "S" itself
+	struct RunStats {
+		struct Thread {
+			// the forms whose leftmost nonterminal was expanded, by level
+			std::vector<std::size_t> expanded_by_level;
+			// the forms with no nonterminal left, before the duplicates are dropped
+			std::size_t finished = 0;
+			// the bytes allocated for the forms derived: their strings' buffers (from the heap or a level arena), their
+			// rope nodes, and their derivations' nodes (the node arenas' blocks) and step vectors
+			std::size_t form_bytes = 0;
+			// time blocked taking from or adding to a queue, and waiting on a barrier
+			std::uint64_t queue_wait_ns = 0;
+			std::uint64_t barrier_wait_ns = 0;
+		};
+
+		std::vector<std::size_t> expanded_by_level;
+		// the forms on each level, just for the level synchronous algorithms (the dual containers, the
+		// controlled queue and the external memory mode). Empty levels are 0
+		std::vector<std::size_t> frontier_by_level;
+		std::size_t finished = 0;
+		// the done strings dropped, or merged into an equal one, by the container they're put on (or the external
+		// memory mode's merge) since one was found already. The memoized expansion adds the yields its cache drops
+		std::size_t duplicates = 0;
+		std::size_t form_bytes = 0;
+		// the memoized yields built again (see Memoization)
+		std::size_t cache_rebuilds = 0;
+		std::uint64_t queue_wait_ns = 0;
+		std::uint64_t barrier_wait_ns = 0;
+		// the calling thread is the first one, the workers follow
+		std::vector<Thread> threads;
+
+		std::string to_json() const
+		{
+			std::string json = "{";
+			auto field = [&json](const char* name, auto value) {
+				json += '"';
+				json += name;
+				json += "\": ";
+				json += std::to_string(value);
+				json += ", ";
+			};
+			auto array = [&json](const char* name, const std::vector<std::size_t>& values) {
+				json += '"';
+				json += name;
+				json += "\": [";
+				for (std::size_t i = 0; i < values.size(); i++) {
+					json += (i == 0 ? "" : ", ") + std::to_string(values[i]);
+				}
+				json += "], ";
+			};
+			array("expanded_by_level", expanded_by_level);
+			array("frontier_by_level", frontier_by_level);
+			field("finished", finished);
+			field("duplicates", duplicates);
+			field("form_bytes", form_bytes);
+			field("cache_rebuilds", cache_rebuilds);
+			field("queue_wait_ns", queue_wait_ns);
+			field("barrier_wait_ns", barrier_wait_ns);
+			json += "\"threads\": [";
+			for (std::size_t i = 0; i < threads.size(); i++) {
+				const Thread& thread = threads[i];
+				json += i == 0 ? "{" : ", {";
+				array("expanded_by_level", thread.expanded_by_level);
+				field("finished", thread.finished);
+				field("form_bytes", thread.form_bytes);
+				field("queue_wait_ns", thread.queue_wait_ns);
+				field("barrier_wait_ns", thread.barrier_wait_ns);
+				// drops the last ", "
+				json.resize(json.size() - 2);
+				json += "}";
+			}
+			json += "]}";
+			return json;
+		}
+	};
+
+	namespace detail {
+		// if Types collect a RunStats, see StatsTypeDefs
+		template <typename Types, typename = void>
+		struct collects_stats : std::false_type {};
+		template <typename Types>
+		struct collects_stats<Types, std::void_t<decltype(Types::collect_stats)>> : std::bool_constant<Types::collect_stats> {};
+		template <typename Types>
+		constexpr bool collects_stats_v = collects_stats<Types>::value;
+
+		// a thread's counters, on their own cache lines so the threads don't share them
+		struct alignas(64) ThreadCounters {
+			std::size_t finished = 0;
+			std::size_t duplicates = 0;
+			std::size_t form_bytes = 0;
+			std::size_t cache_rebuilds = 0;
+			std::uint64_t queue_wait_ns = 0;
+			std::uint64_t barrier_wait_ns = 0;
+			// by the steps left, on the collector's lines
+			std::size_t* expanded = nullptr;
+			std::size_t* frontier = nullptr;
+		};
+
+		// the counters of a generation, a slot per thread: 0 for the calling thread, i + 1 for the worker i
+		class StatsCollector {
+		public:
+			StatsCollector(std::size_t num_of_threads, std::size_t depth) :
+				depth(depth),
+				slots(num_of_threads + 1),
+				lines_per_slot((2 * (depth + 1) * sizeof(std::size_t) + sizeof(Line) - 1) / sizeof(Line)),
+				lines(slots.size() * lines_per_slot)
+			{
+				for (std::size_t i = 0; i < slots.size(); i++) {
+					slots[i].expanded = lines[i * lines_per_slot].counts;
+					slots[i].frontier = slots[i].expanded + depth + 1;
+				}
+			}
+			StatsCollector(const StatsCollector&) = delete;
+			StatsCollector& operator=(const StatsCollector&) = delete;
+
+			ThreadCounters* slot(std::size_t i) { return &slots[i]; }
+			std::size_t max_steps() const { return depth; }
+
+			void report(RunStats& stats) const
+			{
+				stats = RunStats();
+				stats.expanded_by_level.assign(depth + 1, 0);
+				stats.frontier_by_level.assign(depth + 1, 0);
+				for (auto& slot: slots) {
+					RunStats::Thread thread;
+					thread.expanded_by_level.assign(depth + 1, 0);
+					// the levels are the steps left, backwards
+					for (std::size_t steps = 0; steps <= depth; steps++) {
+						thread.expanded_by_level[depth - steps] = slot.expanded[steps];
+						stats.expanded_by_level[depth - steps] += slot.expanded[steps];
+						stats.frontier_by_level[depth - steps] += slot.frontier[steps];
+					}
+					thread.finished = slot.finished;
+					thread.form_bytes = slot.form_bytes;
+					thread.queue_wait_ns = slot.queue_wait_ns;
+					thread.barrier_wait_ns = slot.barrier_wait_ns;
+					stats.finished += slot.finished;
+					stats.duplicates += slot.duplicates;
+					stats.form_bytes += slot.form_bytes;
+					stats.cache_rebuilds += slot.cache_rebuilds;
+					stats.queue_wait_ns += slot.queue_wait_ns;
+					stats.barrier_wait_ns += slot.barrier_wait_ns;
+					stats.threads.push_back(std::move(thread));
+				}
+			}
+
+		private:
+			struct alignas(64) Line {
+				std::size_t counts[64 / sizeof(std::size_t)] = {};
+			};
+
+			std::size_t depth;
+			std::vector<ThreadCounters> slots;
+			std::size_t lines_per_slot;
+			std::vector<Line> lines;
+		};
+
+		// this thread's counters and their collector, none unless a generation collecting stats gave it a slot
+		inline ThreadCounters*& thread_counters()
+		{
+			thread_local ThreadCounters* counters = nullptr;
+			return counters;
+		}
+		inline StatsCollector*& thread_collector()
+		{
+			thread_local StatsCollector* collector = nullptr;
+			return collector;
+		}
+
+		// gives this thread slot i of collector, back to the previous one when destroyed
+		class StatsScope {
+		public:
+			StatsScope(StatsCollector* collector, std::size_t i) :
+				previous_counters(thread_counters()),
+				previous_collector(thread_collector())
+			{
+				thread_collector() = collector;
+				thread_counters() = collector != nullptr ? collector->slot(i) : nullptr;
+			}
+			StatsScope(const StatsScope&) = delete;
+			StatsScope& operator=(const StatsScope&) = delete;
+			~StatsScope()
+			{
+				thread_counters() = previous_counters;
+				thread_collector() = previous_collector;
+			}
+
+		private:
+			ThreadCounters* previous_counters;
+			StatsCollector* previous_collector;
+		};
+
+		// what the algorithms record, nothing (and no code) unless enabled
+		template <bool enabled>
+		struct StatsRecorder {
+			template <typename size_type>
+			static void expanded(size_type) {}
+			template <typename size_type>
+			static void frontier(size_type, size_type) {}
+			static void finished() {}
+			static void duplicates(std::size_t) {}
+			static void allocated(std::size_t) {}
+			static void rebuilt(std::size_t) {}
+			template <typename F>
+			static decltype(auto) queue_wait(F&& f) { return f(); }
+			template <typename Barrier>
+			static void barrier_wait(Barrier& barrier) { barrier.Wait(); }
+			// task, on a thread of the calling thread's collector
+			template <typename Task>
+			static Task task(Task task) { return task; }
+		};
+
+		template <>
+		struct StatsRecorder<true> {
+			// a form with steps derivations left has its leftmost nonterminal expanded
+			template <typename size_type>
+			static void expanded(size_type steps) { counters().expanded[clamp(steps)]++; }
+			// count forms are on the level with steps derivations left
+			template <typename size_type>
+			static void frontier(size_type steps, size_type count) { counters().frontier[clamp(steps)] += count; }
+			static void finished() { counters().finished++; }
+			// count done strings were dropped, or merged into an equal one
+			static void duplicates(std::size_t count) { counters().duplicates += count; }
+			// bytes were allocated for a derived form
+			static void allocated(std::size_t bytes) { counters().form_bytes += bytes; }
+			// count memoized yields were built again
+			static void rebuilt(std::size_t count) { counters().cache_rebuilds += count; }
+			template <typename F>
+			static decltype(auto) queue_wait(F&& f)
+			{
+				Timer timer(counters().queue_wait_ns);
+				return f();
+			}
+			template <typename Barrier>
+			static void barrier_wait(Barrier& barrier)
+			{
+				Timer timer(counters().barrier_wait_ns);
+				barrier.Wait();
+			}
+			template <typename Task>
+			static auto task(Task task)
+			{
+				return [task, collector = thread_collector()](auto i) {
+					StatsScope scope(collector, static_cast<std::size_t>(i) + 1);
+					task(i);
+				};
+			}
+
+		private:
+			// adds the time it's alive to ns
+			class Timer {
+			public:
+				explicit Timer(std::uint64_t& ns) : ns(ns), start(std::chrono::steady_clock::now()) {}
+				~Timer()
+				{
+					ns += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+				}
+
+			private:
+				std::uint64_t& ns;
+				std::chrono::steady_clock::time_point start;
+			};
+
+			// a thread without a slot counts on a thread local one that's never reported
+			static ThreadCounters& counters()
+			{
+				ThreadCounters* counters = thread_counters();
+				if (counters != nullptr)
+					return *counters;
+				thread_local ThreadCounters unreported;
+				thread_local std::vector<std::size_t> levels(2);
+				unreported.expanded = &levels[0];
+				unreported.frontier = &levels[1];
+				return unreported;
+			}
+			template <typename size_type>
+			static std::size_t clamp(size_type steps)
+			{
+				StatsCollector* collector = thread_collector();
+				if (collector == nullptr)
+					return 0;
+				return std::min<std::size_t>(static_cast<std::size_t>(steps), collector->max_steps());
+			}
+		};
+
+		template <typename Types>
+		using Stats = StatsRecorder<collects_stats_v<Types>>;
+	}
+}
+#endif // CFG_STRING_GEN_RUN_STATS_H
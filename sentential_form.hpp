@@ -0,0 +1,121 @@
+#ifndef CFG_STRING_GEN_SENTENTIAL_FORM_H
+#define CFG_STRING_GEN_SENTENTIAL_FORM_H
+
+#include "form_arena.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// the fewest derivations and terminals a symbol, a substitution or a string needs to become a terminal string.
+		// Both are unreachable for what never becomes one
+		template <typename size_type>
+		struct Cost {
+			static constexpr size_type unreachable = std::numeric_limits<size_type>::max();
+
+			size_type steps = 0;
+			size_type length = 0;
+
+			Cost& operator+=(const Cost& other)
+			{
+				if (steps == unreachable || other.steps == unreachable) {
+					steps = unreachable;
+					length = unreachable;
+				}
+				else {
+					steps += other.steps;
+					length += other.length;
+				}
+				return *this;
+			}
+		};
+
+		// a substitution of the compiled rules (see CompiledRules): a view of its symbols on their buffer,
+		// its index on all the rules and its index on its nonterminal's rules
+		template <typename size_type>
+		struct Substitution {
+			std::string_view str;
+			size_type rule = 0;
+			size_type alternative = 0;
+
+			size_type size() const { return static_cast<size_type>(str.size()); }
+		};
+
+		// a string being derived and the position of its leftmost nonterminal (npos if it's done).
+		// Everything before that position is terminal, so derivate finds the next one by scanning the
+		// substitution and the terminals after it, instead of the whole string. The position is a
+		// function of the string, so forms are compared and hashed by the string alone
+		template <typename String, typename size_type>
+		struct SententialForm {
+			// the position wasn't computed yet, like on the forms made from a plain string
+			static constexpr size_type unknown = std::numeric_limits<size_type>::max() - 1;
+
+			String str;
+			size_type next = unknown;
+			// what the nonterminals still need, kept by derivate. Valid when next is known
+			Cost<size_type> cost = {};
+
+			bool operator==(const SententialForm& other) const { return str == other.str; }
+			bool operator!=(const SententialForm& other) const { return str != other.str; }
+		};
+
+		// the bytes str allocated (from the heap or its arena), none if it's short enough to be kept in the string
+		template <typename String>
+		std::size_t allocated_bytes(const String& str)
+		{
+			static const std::size_t local = String().capacity();
+			return str.capacity() > local ? (str.capacity() + 1) * sizeof(typename String::value_type) : 0;
+		}
+
+		// the string with substitution replacing the nonterminal at pos, built with one allocation
+		// (instead of copied and then grown by a replace). Adds the bytes it allocated to allocated, if it isn't null.
+		// Overloaded by the form strings that share, see Rope
+		template <typename String, typename Symbols>
+		String derive_string(const String& str, std::size_t pos, std::string_view substitution, const Symbols&, std::size_t* allocated = nullptr)
+		{
+			String new_str = new_form_string<String>();
+			new_str.reserve(str.size() - 1 + substitution.size());
+			new_str.append(str, 0, pos);
+			new_str.append(substitution.data(), substitution.size());
+			new_str.append(str, pos + 1, String::npos);
+			if (allocated != nullptr)
+				*allocated += allocated_bytes(new_str);
+			return new_str;
+		}
+
+		// the leftmost nonterminal of str, derived at pos. Before pos it's all terminal, so it's searched from pos on
+		template <typename String, typename Symbols>
+		std::size_t next_nonterminal(const String& str, const Symbols& symbols, std::size_t pos)
+		{
+			for (; pos < str.size(); pos++) {
+				if (symbols.is_nonterminal(str[pos]))
+					return pos;
+			}
+			return String::npos;
+		}
+
+		// the chars of str in a std::string, once it's done
+		template <typename String>
+		std::string flat_string(const String& str)
+		{
+			return std::string(str.data(), str.size());
+		}
+	}
+}
+
+namespace std
+{
+	template <typename String, typename size_type>
+	struct hash<cfg_string_gen::detail::SententialForm<String, size_type>> {
+		std::size_t operator()(const cfg_string_gen::detail::SententialForm<String, size_type>& form) const
+		{
+			return std::hash<String>()(form.str);
+		}
+	};
+}
+#endif // CFG_STRING_GEN_SENTENTIAL_FORM_H
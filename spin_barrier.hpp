@@ -0,0 +1,96 @@
+#ifndef CFG_STRING_GEN_SPIN_BARRIER_H
+#define CFG_STRING_GEN_SPIN_BARRIER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		struct NoCompletion {
+			void operator()() const {}
+		};
+
+		inline void spin_pause()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			asm volatile("yield");
+#endif
+		}
+
+		// a barrier for the level synchronous algorithms, crossed a few times per level.
+		// Sense reversing: the last thread to arrive runs completion, resets the count and flips the sense, the
+		// others wait for the sense to change. They spin on it for a while, backing off, then yield for a while
+		// and then park on a condition variable, that the last thread notifies only if someone parked. When
+		// there's more threads than hardware threads they don't spin, the one they'd wait for may need their core.
+		// completion runs before any thread leaves, and sees what they did before arriving
+		template <typename Completion = NoCompletion>
+		class SpinBarrier {
+		public:
+			explicit SpinBarrier(std::size_t count, Completion completion = {}) :
+				threshold(count),
+				spin(count <= std::max(1u, std::thread::hardware_concurrency())),
+				completion(std::move(completion)) {}
+			SpinBarrier(const SpinBarrier&) = delete;
+			SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+			void Wait()
+			{
+				// can't flip before this thread arrives
+				bool old_sense = sense.load(std::memory_order_relaxed);
+				if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == threshold) {
+					completion();
+					arrived.store(0, std::memory_order_relaxed);
+					// seq_cst with parked's, a thread parking either sees the flip or is seen
+					sense.store(!old_sense, std::memory_order_seq_cst);
+					if (parked.load(std::memory_order_seq_cst) != 0) {
+						std::lock_guard<std::mutex> lock(mutex);
+						condition.notify_all();
+					}
+					return;
+				}
+				if (spin) {
+					for (std::size_t spun = 0, pauses = 1; spun < max_spin; spun += pauses, pauses = std::min(pauses * 2, max_backoff)) {
+						if (sense.load(std::memory_order_acquire) != old_sense)
+							return;
+						for (std::size_t i = 0; i < pauses; i++) {
+							spin_pause();
+						}
+					}
+				}
+				for (std::size_t i = 0; i < max_yields; i++) {
+					if (sense.load(std::memory_order_acquire) != old_sense)
+						return;
+					std::this_thread::yield();
+				}
+				std::unique_lock<std::mutex> lock(mutex);
+				parked.fetch_add(1, std::memory_order_seq_cst);
+				condition.wait(lock, [this, old_sense] { return sense.load(std::memory_order_seq_cst) != old_sense; });
+				parked.fetch_sub(1, std::memory_order_relaxed);
+			}
+
+		private:
+			// the pauses spun in all, and between two looks at the sense
+			static constexpr std::size_t max_spin = 1 << 12;
+			static constexpr std::size_t max_backoff = 64;
+			static constexpr std::size_t max_yields = 64;
+
+			const std::size_t threshold;
+			const bool spin;
+			Completion completion;
+			std::atomic<std::size_t> arrived = {0};
+			std::atomic<bool> sense = {false};
+			std::atomic<std::size_t> parked = {0};
+			std::mutex mutex;
+			std::condition_variable condition;
+		};
+	}
+}
+#endif // CFG_STRING_GEN_SPIN_BARRIER_H
@@ -0,0 +1,74 @@
+// times the barriers the level synchronous algorithms could cross: the mutex one (barrier.hpp),
+// SpinBarrier and std::barrier (when built as C++20). Each thread crosses the barrier rounds times,
+// doing a little work between crossings, like the threads of the dual containers on a tiny level.
+// usage: barrier_bench [rounds] [work], prints the nanoseconds per crossing for 2 to 64 threads
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../barrier.hpp"
+#include "../spin_barrier.hpp"
+#if __cplusplus >= 202002L && __has_include(<barrier>)
+#include <barrier>
+#endif
+
+template <typename Barrier>
+double ns_per_crossing(Barrier& barrier, std::size_t num_of_threads, std::size_t rounds, std::size_t work)
+{
+	auto run = [&]() {
+		volatile std::size_t sink = 0;
+		for (std::size_t r = 0; r < rounds; r++) {
+			for (std::size_t w = 0; w < work; w++) {
+				sink = sink + w;
+			}
+			barrier.Wait();
+		}
+	};
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (std::size_t i = 1; i < num_of_threads; i++) {
+		threads.emplace_back(run);
+	}
+	run();
+	for (auto& thread: threads) {
+		thread.join();
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / static_cast<double>(rounds);
+}
+
+#if __cplusplus >= 202002L && __has_include(<barrier>)
+// std::barrier with the same interface
+struct StdBarrier {
+	explicit StdBarrier(std::size_t count) : barrier(static_cast<std::ptrdiff_t>(count)) {}
+	void Wait() { barrier.arrive_and_wait(); }
+	std::barrier<> barrier;
+};
+#endif
+
+int main(int argc, char** argv)
+{
+	const std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+	const std::size_t work = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+
+	std::cout << "threads,mutex,spin";
+#if __cplusplus >= 202002L && __has_include(<barrier>)
+	std::cout << ",std";
+#endif
+	std::cout << std::endl;
+	for (std::size_t num_of_threads = 2; num_of_threads <= 64; num_of_threads *= 2) {
+		Barrier mutex_barrier(num_of_threads);
+		cfg_string_gen::detail::SpinBarrier<> spin_barrier(num_of_threads);
+		std::cout << num_of_threads;
+		std::cout << "," << ns_per_crossing(mutex_barrier, num_of_threads, rounds, work);
+		std::cout << "," << ns_per_crossing(spin_barrier, num_of_threads, rounds, work);
+#if __cplusplus >= 202002L && __has_include(<barrier>)
+		StdBarrier std_barrier(num_of_threads);
+		std::cout << "," << ns_per_crossing(std_barrier, num_of_threads, rounds, work);
+#endif
+		std::cout << std::endl;
+	}
+}
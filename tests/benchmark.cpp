@@ -0,0 +1,512 @@
+// the benchmark suite: runs each engine, collecting the strings and streaming them to a sink, over a catalog of
+// grammars with different ambiguity and fan-out, at a few depths and thread counts. Each run is a child process,
+// so the peak RSS getrusage gives for it is just its own. Writes a CSV line per run (throughput and peak RSS) and,
+// for the streaming runs, a CSV line per level with the percentiles of the strings' arrival times: the time since
+// the run started when the strings of that level reached the sink. A string's level is the length of its derivation,
+// or without derivations the fewest derivation steps that make it, found once the run is measured. With a baseline
+// (a results CSV of an earlier build, that must exist) it compares the runs with it, and exits with 1 if any got
+// slower or bigger than the tolerance or generated a different number of strings.
+// usage: benchmark [--out results.csv] [--arrivals-out arrivals.csv] [--baseline baseline.csv] [--tolerance 0.15]
+//                  [--threads 1,4] [--repeat 5] [--filter text]
+// --threads defaults to 1 and the hardware threads, --filter runs just the runs with text on their key
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../cfg_string_generator.hpp"
+
+using Rules = std::unordered_map<char, std::vector<std::string>>;
+using Clock = std::chrono::steady_clock;
+
+struct Grammar {
+	const char* name;
+	Rules rules;
+	// the depths for the strings, the derivations use the first ones (they're a lot heavier)
+	std::vector<std::size_t> depths;
+	std::size_t derivation_depths;
+};
+
+// unambiguous grammars and ambiguous ones (the duplicates are dropped), with a fan-out from 2 to 8
+std::vector<Grammar> catalog()
+{
+	return {
+		// main.cpp's, the strings with as many 0s as 1s: ambiguous, fan-out 2 and 3
+		{"balanced", {{'S', {"0A", "1B"}}, {'A', {"0AA", "1S", "1"}}, {'B', {"1BB", "0S", "0"}}}, {17, 19}, 1},
+		// very ambiguous, fan-out 4
+		{"expression", {{'S', {"S+S", "S*S", "(S)", "a"}}}, {11, 12}, 1},
+		// left recursive, unambiguous, a chain of nonterminals
+		{"arithmetic", {{'S', {"S+T", "T"}}, {'T', {"T*F", "F"}}, {'F', {"(S)", "a", "b"}}}, {16, 18}, 1},
+		// unambiguous, fan-out 8, a level per char
+		{"wide", {{'S', {"aS", "bS", "cS", "dS", "a", "b", "c", "d"}}}, {7, 8}, 1},
+		// unambiguous, fan-out 4 but a single form per string, a lot of tiny levels
+		{"palindrome", {{'S', {"0S0", "1S1", "0", "1"}}}, {14, 16}, 1},
+		// unambiguous, fan-out 2, long forms with the nonterminal at the end: the _rescan engines find it from the
+		// form's start each step, the repetition ones don't hash the forms, so the scan is most of their work
+		{"long", {{'S', {"abcdefghijklmnopS", "ponmlkjihgfedcbaS", "x"}}}, {17, 18}, 1},
+	};
+}
+
+// the arrival times of the strings of a level, in ms since the run started
+struct LevelArrivals {
+	std::size_t level;
+	std::size_t strings;
+	double p50_ms, p90_ms, p99_ms, max_ms;
+};
+
+struct Result {
+	std::size_t strings = 0;
+	double seconds = 0;
+	long peak_rss_kb = 0;
+	std::vector<LevelArrivals> arrivals;
+};
+
+// when each string reached the sink, since the run started, with a key for its level: the level itself or the
+// string's hash, for level_of. Each thread adds to its own slot, like OutputFingerprinter, and by_level() merges
+// them once the run is done
+class Arrivals {
+public:
+	explicit Arrivals(Clock::time_point start) : start(start), slots(new Slot[num_of_slots]) {}
+
+	void add(std::size_t key)
+	{
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		Slot& slot = slots[thread_slot() % num_of_slots];
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		slot.times.emplace_back(key, ms);
+	}
+
+	std::size_t size() const
+	{
+		std::size_t size = 0;
+		for (std::size_t i = 0; i < num_of_slots; i++)
+			size += slots[i].times.size();
+		return size;
+	}
+
+	template <typename LevelOf>
+	std::vector<LevelArrivals> by_level(LevelOf level_of)
+	{
+		std::vector<std::pair<std::size_t, double>> times;
+		times.reserve(size());
+		for (std::size_t i = 0; i < num_of_slots; i++) {
+			for (auto& [key, ms]: slots[i].times)
+				times.emplace_back(level_of(key), ms);
+		}
+		std::sort(times.begin(), times.end());
+		std::vector<LevelArrivals> arrivals;
+		for (std::size_t begin = 0, end; begin < times.size(); begin = end) {
+			end = begin;
+			while (end < times.size() && times[end].first == times[begin].first)
+				end++;
+			// sorted by time within the level too
+			auto at = [&](double p) { return times[begin + static_cast<std::size_t>(p * static_cast<double>(end - begin - 1))].second; };
+			arrivals.push_back({times[begin].first, end - begin, at(0.5), at(0.9), at(0.99), times[end - 1].second});
+		}
+		return arrivals;
+	}
+
+private:
+	static const std::size_t num_of_slots = 64;
+	// locked since two threads can share a slot, they're rarely contended
+	struct alignas(64) Slot {
+		std::mutex mutex;
+		std::vector<std::pair<std::size_t, double>> times;
+	};
+
+	// a number for this thread, the threads of the pool get different ones
+	static std::size_t thread_slot()
+	{
+		static std::atomic<std::size_t> next = {0};
+		thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+		return slot;
+	}
+
+	Clock::time_point start;
+	std::unique_ptr<Slot[]> slots;
+};
+
+// the level of each string generated at depth, by its hash: the fewest derivation steps that make it,
+// found by generating every depth up to it
+std::unordered_map<std::size_t, std::size_t> string_levels(const Rules& rules, std::size_t depth)
+{
+	std::unordered_map<std::size_t, std::size_t> levels;
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = 1;
+	for (std::size_t d = 0; d <= depth; d++) {
+		cfg_string_gen::cfg_string_generator<false, false, false, true, false, true>(rules, d, [&](auto&& s) {
+			levels.emplace(std::hash<std::string>()(s), d);
+		}, options);
+	}
+	return levels;
+}
+
+// this process' peak RSS, in KiB on Linux
+long peak_rss_kb()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// the default types, but a form's leftmost nonterminal is found by scanning it from the start (as the engines did
+// before the forms kept its position), to measure what keeping it saves
+template <bool low_memory>
+struct RescanTypeDefs : cfg_string_gen::TypeDefs<low_memory> {
+	using base = cfg_string_gen::TypeDefs<low_memory>;
+	struct functions : base::functions {
+		using base::functions::find_nonterminal;
+		template <typename Symbols>
+		static typename base::size_type find_nonterminal(const typename base::form_type& form, const Symbols& symbols)
+		{
+			return base::functions::find_nonterminal(form.str, symbols);
+		}
+	};
+};
+
+template <bool derivation, bool repetition, bool fast, bool derivation_fq, bool single_threaded, bool work_stealing, bool depth_first,
+			template <bool low_mem> typename TypeDefs = cfg_string_gen::TypeDefs>
+Result run(const Rules& rules, std::size_t depth, std::size_t num_of_threads, bool stream, cfg_string_gen::ExternalMemory external, cfg_string_gen::Memoization memo)
+{
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = num_of_threads;
+	options.external = external;
+	options.memo = memo;
+	Result result;
+	auto start = Clock::now();
+	if (stream) {
+		Arrivals arrivals(start);
+		cfg_string_gen::cfg_string_generator<derivation, repetition, false, fast, derivation_fq, single_threaded, work_stealing, depth_first, TypeDefs>(rules, depth, [&](auto&& s) {
+			if constexpr(derivation) {
+				std::size_t level = s.second.front().size();
+				for (auto& steps: s.second)
+					level = std::min<std::size_t>(level, steps.size());
+				arrivals.add(level);
+			}
+			else {
+				arrivals.add(std::hash<std::string>()(s));
+			}
+		}, options);
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.peak_rss_kb = peak_rss_kb();
+		result.strings = arrivals.size();
+		if constexpr(derivation) {
+			result.arrivals = arrivals.by_level([](std::size_t level) { return level; });
+		}
+		else {
+			auto levels = string_levels(rules, depth);
+			result.arrivals = arrivals.by_level([&](std::size_t hash) { return levels.at(hash); });
+		}
+	}
+	else {
+		auto strings = cfg_string_gen::cfg_string_generator<derivation, repetition, false, fast, derivation_fq, single_threaded, work_stealing, depth_first, TypeDefs>(rules, depth, options);
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.peak_rss_kb = peak_rss_kb();
+		result.strings = strings.size();
+	}
+	return result;
+}
+
+struct Engine {
+	const char* name;
+	bool derivation;
+	bool single_threaded;
+	Result (*run)(const Rules&, std::size_t, std::size_t, bool, cfg_string_gen::ExternalMemory, cfg_string_gen::Memoization);
+	cfg_string_gen::ExternalMemory external;
+	cfg_string_gen::Memoization memo;
+};
+
+// every engine cfg_string_generator picks, the external memory and the memoized ones are the dual containers' modes.
+// The _repetition ones keep the duplicates, the _arena, _rope, _fingerprint and _compact ones use those TypeDefs,
+// the _rescan ones RescanTypeDefs
+std::vector<Engine> engines()
+{
+	cfg_string_gen::ExternalMemory external;
+	external.budget = 16 << 20;
+	cfg_string_gen::Memoization memo;
+	memo.cache_budget = 64 << 20;
+	using Compact = cfg_string_gen::CompactTypeDefs<std::uint8_t>;
+	using Fingerprint = cfg_string_gen::FingerprintTypeDefs<>;
+	return {
+		{"controlled_queue", false, false, run<false, false, false, false, false, false, false>, {}, {}},
+		{"dual_containers", false, false, run<false, false, true, false, false, false, false>, {}, {}},
+		{"work_stealing", false, false, run<false, false, false, false, false, true, false>, {}, {}},
+		{"depth_first", false, false, run<false, false, false, false, false, false, true>, {}, {}},
+		{"external", false, false, run<false, false, true, false, false, false, false>, external, {}},
+		{"memoized", false, false, run<false, false, true, false, false, false, false>, {}, memo},
+		{"controlled_queue_st", false, true, run<false, false, false, false, true, false, false>, {}, {}},
+		{"dual_containers_st", false, true, run<false, false, true, false, true, false, false>, {}, {}},
+		{"controlled_queue_repetition", false, false, run<false, true, false, false, false, false, false>, {}, {}},
+		{"dual_containers_repetition", false, false, run<false, true, true, false, false, false, false>, {}, {}},
+		{"work_stealing_repetition", false, false, run<false, true, false, false, false, true, false>, {}, {}},
+		{"depth_first_repetition", false, false, run<false, true, false, false, false, false, true>, {}, {}},
+		{"dual_containers_repetition_rescan", false, false, run<false, true, true, false, false, false, false, RescanTypeDefs>, {}, {}},
+		{"depth_first_repetition_rescan", false, false, run<false, true, false, false, false, false, true, RescanTypeDefs>, {}, {}},
+		{"dual_containers_arena", false, false, run<false, false, true, false, false, false, false, cfg_string_gen::ArenaTypeDefs>, {}, {}},
+		{"dual_containers_rope", false, false, run<false, false, true, false, false, false, false, cfg_string_gen::RopeTypeDefs>, {}, {}},
+		{"dual_containers_fingerprint", false, false, run<false, false, true, false, false, false, false, Fingerprint::type>, {}, {}},
+		{"controlled_queue", true, false, run<true, false, false, false, false, false, false>, {}, {}},
+		{"free_queue", true, false, run<true, false, false, true, false, false, false>, {}, {}},
+		{"dual_containers", true, false, run<true, false, true, false, false, false, false>, {}, {}},
+		{"work_stealing", true, false, run<true, false, false, false, false, true, false>, {}, {}},
+		{"depth_first", true, false, run<true, false, false, false, false, false, true>, {}, {}},
+		{"controlled_queue_st", true, true, run<true, false, false, false, true, false, false>, {}, {}},
+		{"free_queue_st", true, true, run<true, false, false, true, true, false, false>, {}, {}},
+		{"dual_containers_st", true, true, run<true, false, true, false, true, false, false>, {}, {}},
+		{"controlled_queue_repetition", true, false, run<true, true, false, false, false, false, false>, {}, {}},
+		{"free_queue_repetition", true, false, run<true, true, false, true, false, false, false>, {}, {}},
+		{"dual_containers_repetition", true, false, run<true, true, true, false, false, false, false>, {}, {}},
+		{"work_stealing_repetition", true, false, run<true, true, false, false, false, true, false>, {}, {}},
+		{"depth_first_repetition", true, false, run<true, true, false, false, false, false, true>, {}, {}},
+		{"dual_containers_compact", true, false, run<true, false, true, false, false, false, false, Compact::type>, {}, {}},
+		{"work_stealing_compact", true, false, run<true, false, false, false, false, true, false, Compact::type>, {}, {}},
+	};
+}
+
+// runs f on a child process, with the result written back on a pipe. false if it failed.
+// The peak RSS is the child's own, taken by f before anything it does after the run
+template <typename F>
+bool run_child(F f, Result& result)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	std::cout.flush();
+	std::cerr.flush();
+	pid_t pid = fork();
+	if (pid < 0)
+		return false;
+	if (pid == 0) {
+		close(fds[0]);
+		int status = 0;
+		std::ostringstream out;
+		try {
+			Result child = f();
+			out << child.strings << ' ' << child.seconds << ' ' << child.peak_rss_kb << '\n';
+			for (auto& arrivals: child.arrivals)
+				out << arrivals.level << ' ' << arrivals.strings << ' ' << arrivals.p50_ms << ' ' << arrivals.p90_ms << ' ' << arrivals.p99_ms << ' ' << arrivals.max_ms << '\n';
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			status = 1;
+		}
+		std::string text = out.str();
+		for (std::size_t written = 0; written < text.size();) {
+			ssize_t n = write(fds[1], text.data() + written, text.size() - written);
+			if (n <= 0)
+				break;
+			written += static_cast<std::size_t>(n);
+		}
+		close(fds[1]);
+		// the threads of the pool are still there, no destructors
+		_exit(status);
+	}
+	close(fds[1]);
+	std::string text;
+	char buffer[4096];
+	for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;)
+		text.append(buffer, static_cast<std::size_t>(n));
+	close(fds[0]);
+	int status = 0;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return false;
+	std::istringstream in(text);
+	if (!(in >> result.strings >> result.seconds >> result.peak_rss_kb))
+		return false;
+	result.arrivals.clear();
+	for (LevelArrivals arrivals; in >> arrivals.level >> arrivals.strings >> arrivals.p50_ms >> arrivals.p90_ms >> arrivals.p99_ms >> arrivals.max_ms;)
+		result.arrivals.push_back(arrivals);
+	return true;
+}
+
+struct Baseline {
+	std::size_t strings;
+	double strings_per_s;
+	long peak_rss_kb;
+};
+
+const char* results_header = "grammar,depth,kind,engine,mode,threads,strings,seconds,strings_per_s,peak_rss_kb";
+
+// the runs of a results CSV by their key, the first 6 columns
+std::map<std::string, Baseline> load_baseline(const std::string& path)
+{
+	std::map<std::string, Baseline> baseline;
+	std::ifstream in(path);
+	std::string line;
+	std::getline(in, line);
+	while (std::getline(in, line)) {
+		std::vector<std::string> columns;
+		std::istringstream fields(line);
+		for (std::string column; std::getline(fields, column, ',');)
+			columns.push_back(column);
+		if (columns.size() < 10)
+			continue;
+		std::string key = columns[0];
+		for (std::size_t i = 1; i < 6; i++)
+			key += ',' + columns[i];
+		baseline[key] = {std::strtoul(columns[6].c_str(), nullptr, 10), std::strtod(columns[8].c_str(), nullptr), std::strtol(columns[9].c_str(), nullptr, 10)};
+	}
+	return baseline;
+}
+
+int main(int argc, char** argv)
+{
+	std::string out_path = "bench_results.csv";
+	std::string arrivals_path = "bench_arrivals.csv";
+	std::string baseline_path;
+	std::string filter;
+	double tolerance = 0.15;
+	std::size_t repeat = 5;
+	std::vector<std::size_t> thread_counts = {1, std::max(1u, std::thread::hardware_concurrency())};
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string option = argv[i];
+		std::string value = argv[i + 1];
+		if (option == "--out")
+			out_path = value;
+		else if (option == "--arrivals-out")
+			arrivals_path = value;
+		else if (option == "--baseline")
+			baseline_path = value;
+		else if (option == "--tolerance")
+			tolerance = std::strtod(value.c_str(), nullptr);
+		else if (option == "--repeat")
+			repeat = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+		else if (option == "--filter")
+			filter = value;
+		else if (option == "--threads") {
+			thread_counts.clear();
+			std::istringstream counts(value);
+			for (std::string count; std::getline(counts, count, ',');)
+				thread_counts.push_back(std::strtoul(count.c_str(), nullptr, 10));
+		}
+		else {
+			std::cerr << "unknown option " << option << std::endl;
+			return 2;
+		}
+	}
+#ifndef __OPTIMIZE__
+	std::cerr << "benchmark: built without optimizations, the times say little" << std::endl;
+#endif
+	std::sort(thread_counts.begin(), thread_counts.end());
+	thread_counts.erase(std::unique(thread_counts.begin(), thread_counts.end()), thread_counts.end());
+
+	std::map<std::string, Baseline> baseline;
+	if (!baseline_path.empty()) {
+		if (!std::ifstream(baseline_path)) {
+			std::cerr << "no baseline at " << baseline_path << ", make one with the bench_baseline target" << std::endl;
+			return 1;
+		}
+		baseline = load_baseline(baseline_path);
+	}
+	auto slower = [&](const std::string& key, const Result& result) {
+		auto found = baseline.find(key);
+		return found != baseline.end() && static_cast<double>(result.strings) < found->second.strings_per_s * (1 - tolerance) * result.seconds;
+	};
+
+	std::ofstream out(out_path);
+	std::ofstream arrivals_out(arrivals_path);
+	out << results_header << std::endl;
+	arrivals_out << "grammar,depth,kind,engine,threads,level,strings,arrival_p50_ms,arrival_p90_ms,arrival_p99_ms,arrival_max_ms" << std::endl;
+	std::map<std::string, Result> results;
+	bool failed = false;
+	for (auto& grammar: catalog()) {
+		for (auto& engine: engines()) {
+			std::size_t depths = engine.derivation ? grammar.derivation_depths : grammar.depths.size();
+			for (std::size_t d = 0; d < depths; d++) {
+				std::size_t depth = grammar.depths[d];
+				for (std::size_t num_of_threads: thread_counts) {
+					// the single threaded engines just once
+					if (engine.single_threaded && num_of_threads != thread_counts.front())
+						continue;
+					for (bool stream: {false, true}) {
+						std::string key = std::string(grammar.name) + ',' + std::to_string(depth) + ',' + (engine.derivation ? "derivations" : "strings") + ','
+											+ engine.name + ',' + (stream ? "stream" : "collect") + ',' + std::to_string(engine.single_threaded ? 1 : num_of_threads);
+						if (key.find(filter) == std::string::npos)
+							continue;
+						// the best time, the others had more noise from the rest of the machine, and the highest peak.
+						// A run slower than the baseline's is measured again before it's taken as a regression
+						Result result;
+						result.seconds = -1;
+						bool ok = true;
+						for (std::size_t round = 0; ok && round < 3 && (round == 0 || slower(key, result)); round++) {
+							for (std::size_t i = 0; ok && i < repeat; i++) {
+								Result r;
+								ok = run_child([&]() { return engine.run(grammar.rules, depth, num_of_threads, stream, engine.external, engine.memo); }, r);
+								long peak = std::max(result.peak_rss_kb, r.peak_rss_kb);
+								if (ok && (result.seconds < 0 || r.seconds < result.seconds))
+									result = std::move(r);
+								result.peak_rss_kb = peak;
+							}
+						}
+						if (!ok) {
+							std::cerr << key << ": failed" << std::endl;
+							failed = true;
+							continue;
+						}
+						double strings_per_s = result.seconds > 0 ? static_cast<double>(result.strings) / result.seconds : 0;
+						out << key << ',' << result.strings << ',' << result.seconds << ',' << strings_per_s << ',' << result.peak_rss_kb << std::endl;
+						std::cout << key << ": " << result.strings << " strings, " << result.seconds << " s, " << strings_per_s << " strings/s, " << result.peak_rss_kb << " KiB" << std::endl;
+						// the key without the mode, just the streaming runs have arrivals
+						std::string arrivals_key = key.substr(0, key.rfind(',', key.rfind(',') - 1)) + key.substr(key.rfind(','));
+						for (auto& arrivals: result.arrivals) {
+							arrivals_out << arrivals_key << ',' << arrivals.level << ',' << arrivals.strings << ',' << arrivals.p50_ms << ',' << arrivals.p90_ms << ','
+										<< arrivals.p99_ms << ',' << arrivals.max_ms << std::endl;
+						}
+						results[key] = std::move(result);
+					}
+				}
+			}
+		}
+	}
+
+	if (baseline_path.empty())
+		return failed;
+	// small RSS growths are noise
+	std::size_t compared = 0, regressions = 0;
+	double log_ratios = 0;
+	for (auto& [key, result]: results) {
+		auto found = baseline.find(key);
+		if (found == baseline.end())
+			continue;
+		const Baseline& base = found->second;
+		compared++;
+		double strings_per_s = result.seconds > 0 ? static_cast<double>(result.strings) / result.seconds : 0;
+		double ratio = base.strings_per_s > 0 ? strings_per_s / base.strings_per_s : 1;
+		log_ratios += std::log(ratio);
+		if (result.strings != base.strings) {
+			std::cout << "MISMATCH " << key << ": " << result.strings << " strings, the baseline has " << base.strings << std::endl;
+			regressions++;
+		}
+		else if (slower(key, result)) {
+			std::cout << "SLOWER " << key << ": " << strings_per_s << " strings/s, the baseline has " << base.strings_per_s << std::endl;
+			regressions++;
+		}
+		else if (result.peak_rss_kb > base.peak_rss_kb * (1 + tolerance) && result.peak_rss_kb - base.peak_rss_kb > 4096) {
+			std::cout << "BIGGER " << key << ": " << result.peak_rss_kb << " KiB, the baseline has " << base.peak_rss_kb << std::endl;
+			regressions++;
+		}
+	}
+	std::cout << compared << " runs compared with " << baseline_path << ", " << regressions << " regressions";
+	if (compared != 0)
+		std::cout << ", throughput " << std::exp(log_ratios / static_cast<double>(compared)) << "x the baseline's (geometric mean)";
+	std::cout << std::endl;
+	return failed || regressions != 0;
+}
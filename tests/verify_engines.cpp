@@ -0,0 +1,297 @@
+// checks that every engine gives the same output as the single threaded controlled queue, by their
+// OutputFingerprint, over a catalog of grammars, at every depth up to a grammar's most and a few thread counts,
+// collecting the strings and streaming them. Without repetition each string keeps any one of its derivations,
+// so just the strings are compared then. With repetition, the fingerprints of the shards of a generation must
+// add up to the whole one's too. With a LengthBound, up to and of exactly a length, every engine must give the
+// reference's unbounded output with the other strings dropped. The external memory mode's spill failing on a
+// worker thread must reach the caller.
+// cfg_string_count must match the sizes of the repetition mode outputs, by length and by derivation steps.
+// usage: verify_engines [--threads 1,2,5], prints the mismatches and exits with 1 if there's any
+
+#ifdef __unix__
+#include <sys/resource.h>
+#include <csignal>
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../cfg_string_count.hpp"
+#include "../cfg_string_generator.hpp"
+#include "../output_fingerprint.hpp"
+
+using Rules = std::unordered_map<char, std::vector<std::string>>;
+using cfg_string_gen::OutputFingerprint;
+
+struct Grammar {
+	const char* name;
+	Rules rules;
+	std::size_t max_depth;
+};
+
+std::vector<Grammar> catalog()
+{
+	return {
+		// main.cpp's, ambiguous
+		{"balanced", {{'S', {"0A", "1B"}}, {'A', {"0AA", "1S", "1"}}, {'B', {"1BB", "0S", "0"}}}, 12},
+		// very ambiguous
+		{"expression", {{'S', {"S+S", "S*S", "(S)", "a"}}}, 7},
+		// left recursive, a chain of nonterminals
+		{"arithmetic", {{'S', {"S+T", "T"}}, {'T', {"T*F", "F"}}, {'F', {"(S)", "a", "b"}}}, 10},
+		// fan-out 8
+		{"wide", {{'S', {"aS", "bS", "cS", "dS", "a", "b", "c", "d"}}}, 4},
+		// a single form per string
+		{"palindrome", {{'S', {"0S0", "1S1", "0", "1"}}}, 10},
+		// the same strings on derivations of different lengths
+		{"lengths", {{'S', {"SS", "A", "a"}}, {'A', {"a", "aA"}}}, 7},
+	};
+}
+
+struct Engine {
+	std::string name;
+	bool single_threaded;
+	OutputFingerprint (*run)(const Rules&, std::size_t, std::size_t, cfg_string_gen::Shard, cfg_string_gen::LengthBound, bool,
+								cfg_string_gen::ExternalMemory, cfg_string_gen::Memoization);
+	cfg_string_gen::ExternalMemory external;
+	cfg_string_gen::Memoization memo;
+};
+
+template <bool derivation, bool repetition, bool low_memory, bool fast, bool derivation_fq, bool single_threaded, bool work_stealing, bool depth_first,
+			template <bool low_mem> typename TypeDefs = cfg_string_gen::TypeDefs>
+OutputFingerprint fingerprint(const Rules& rules, std::size_t depth, std::size_t num_of_threads, cfg_string_gen::Shard shard,
+								cfg_string_gen::LengthBound bound, bool stream, cfg_string_gen::ExternalMemory external, cfg_string_gen::Memoization memo)
+{
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = num_of_threads;
+	options.shard = shard;
+	options.bound = bound;
+	options.external = external;
+	options.memo = memo;
+	cfg_string_gen::OutputFingerprinter<Rules> fingerprinter(rules);
+	if (stream) {
+		cfg_string_gen::cfg_string_generator<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, TypeDefs>(
+			rules, depth, fingerprinter, options);
+	}
+	else {
+		fingerprinter.add_all(cfg_string_gen::cfg_string_generator<derivation, repetition, low_memory, fast, derivation_fq, single_threaded, work_stealing, depth_first, TypeDefs>(
+			rules, depth, options));
+	}
+	return fingerprinter.fingerprint();
+}
+
+// the output of the reference engine without a bound, keeping just the strings within bound
+template <bool derivation, bool repetition>
+OutputFingerprint bounded_reference(const Rules& rules, std::size_t depth, cfg_string_gen::LengthBound bound)
+{
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = 1;
+	cfg_string_gen::OutputFingerprinter<Rules> fingerprinter(rules);
+	for (auto& s: cfg_string_gen::cfg_string_generator<derivation, repetition, false, false, false, true>(rules, depth, options)) {
+		std::size_t length;
+		if constexpr(derivation)
+			length = s.first.size();
+		else
+			length = s.size();
+		if (bound.exact ? length == bound.length : length <= bound.length)
+			fingerprinter(s);
+	}
+	return fingerprinter.fingerprint();
+}
+
+// the engines of a mode, the reference first
+template <bool derivation, bool repetition>
+std::vector<Engine> engines()
+{
+	constexpr bool d = derivation, r = repetition;
+	std::vector<Engine> engines = {
+		{"controlled_queue_st", true, fingerprint<d, r, false, false, false, true, false, false>, {}, {}},
+		{"controlled_queue", false, fingerprint<d, r, false, false, false, false, false, false>, {}, {}},
+		{"dual_containers", false, fingerprint<d, r, false, true, false, false, false, false>, {}, {}},
+		{"dual_containers_st", true, fingerprint<d, r, false, true, false, true, false, false>, {}, {}},
+		{"work_stealing", false, fingerprint<d, r, false, false, false, false, true, false>, {}, {}},
+		{"depth_first", false, fingerprint<d, r, false, false, false, false, false, true>, {}, {}},
+		{"dual_containers_arena", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::ArenaTypeDefs>, {}, {}},
+		{"dual_containers_rope", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::RopeTypeDefs>, {}, {}},
+	};
+	if constexpr(derivation) {
+		engines.push_back({"free_queue", false, fingerprint<d, r, false, false, true, false, false, false>, {}, {}});
+		engines.push_back({"free_queue_st", true, fingerprint<d, r, false, false, true, true, false, false>, {}, {}});
+		engines.push_back({"controlled_queue_low_memory", false, fingerprint<d, r, true, false, false, false, false, false>, {}, {}});
+		engines.push_back({"dual_containers_low_memory", false, fingerprint<d, r, true, true, false, false, false, false>, {}, {}});
+		engines.push_back({"work_stealing_compact", false, fingerprint<d, r, false, false, false, false, true, false, cfg_string_gen::CompactTypeDefs<std::uint8_t>::type>, {}, {}});
+		engines.push_back({"dual_containers_compact", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::CompactTypeDefs<std::uint8_t>::type>, {}, {}});
+	}
+	else {
+		cfg_string_gen::ExternalMemory external;
+		// small enough to spill the bigger levels
+		external.budget = 1 << 12;
+		cfg_string_gen::Memoization memo;
+		memo.cache_budget = 1 << 20;
+		engines.push_back({"external", false, fingerprint<d, r, false, true, false, false, false, false>, external, {}});
+		engines.push_back({"memoized", false, fingerprint<d, r, false, true, false, false, false, false>, {}, memo});
+		engines.push_back({"dual_containers_fingerprint", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::FingerprintTypeDefs<std::uint64_t, true>::type>, {}, {}});
+		// without exact, a fingerprint collision would lose a string, not likely on these grammars
+		engines.push_back({"dual_containers_fingerprint_filter", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::FingerprintTypeDefs<>::type>, {}, {}});
+		engines.push_back({"controlled_queue_fingerprint_filter", false, fingerprint<d, r, false, false, false, false, false, false, cfg_string_gen::FingerprintTypeDefs<>::type>, {}, {}});
+		engines.push_back({"dual_containers_fingerprint128", false, fingerprint<d, r, false, true, false, false, false, false, cfg_string_gen::FingerprintTypeDefs<cfg_string_gen::Fingerprint128>::type>, {}, {}});
+	}
+	return engines;
+}
+
+// compares the engines of a mode, returns the mismatches
+template <bool derivation, bool repetition>
+std::size_t verify(const std::vector<std::size_t>& thread_counts)
+{
+	const std::string mode = std::string(derivation ? "derivations" : "strings") + (repetition ? " with repetition" : "");
+	auto same = [](const OutputFingerprint& a, const OutputFingerprint& b) { return derivation && !repetition ? a.same_strings(b) : a == b; };
+	std::size_t mismatches = 0, runs = 0;
+	auto all = engines<derivation, repetition>();
+	for (auto& grammar: catalog()) {
+		for (std::size_t depth = 0; depth <= grammar.max_depth; depth++) {
+			const Engine& reference = all.front();
+			OutputFingerprint expected = reference.run(grammar.rules, depth, 1, {}, {}, false, reference.external, reference.memo);
+			auto check = [&](const std::string& what, const OutputFingerprint& got) {
+				runs++;
+				if (same(got, expected))
+					return;
+				mismatches++;
+				std::cout << "MISMATCH " << mode << ", " << grammar.name << " at depth " << depth << ", " << what << ": "
+							<< got.to_string() << ", expected " << expected.to_string() << std::endl;
+			};
+			for (auto& engine: all) {
+				for (std::size_t num_of_threads: thread_counts) {
+					if (engine.single_threaded && num_of_threads != thread_counts.front())
+						continue;
+					for (bool stream: {false, true}) {
+						std::ostringstream what;
+						what << engine.name << (stream ? " streaming" : "") << " on " << num_of_threads << " threads";
+						check(what.str(), engine.run(grammar.rules, depth, num_of_threads, {}, {}, stream, engine.external, engine.memo));
+					}
+				}
+				// a string may be on more than one shard without repetition
+				if constexpr(repetition) {
+					OutputFingerprint shards;
+					for (std::size_t index = 0; index < 3; index++)
+						shards += engine.run(grammar.rules, depth, thread_counts.back(), {index, 3}, {}, false, engine.external, engine.memo);
+					check(engine.name + " on 3 shards", shards);
+				}
+			}
+			// about half the longest strings, on the most threads
+			cfg_string_gen::LengthBound bounds[2];
+			bounds[0].length = bounds[1].length = depth / 2 + 1;
+			bounds[1].exact = true;
+			for (auto& bound: bounds) {
+				expected = bounded_reference<derivation, repetition>(grammar.rules, depth, bound);
+				for (auto& engine: all) {
+					for (bool stream: {false, true}) {
+						std::ostringstream what;
+						what << engine.name << (stream ? " streaming" : "") << " on " << thread_counts.back() << " threads, "
+							<< (bound.exact ? "of length " : "up to length ") << bound.length;
+						check(what.str(), engine.run(grammar.rules, depth, thread_counts.back(), {}, bound, stream, engine.external, engine.memo));
+					}
+				}
+			}
+		}
+	}
+	std::cout << mode << ": " << runs << " runs, " << mismatches << " mismatches" << std::endl;
+	return mismatches;
+}
+
+// cfg_string_count against the outputs it counts: the strings with repetition by length and the derivations
+// by steps, at every depth. Returns the mismatches
+std::size_t counts()
+{
+	using cfg_string_gen::count_type;
+	std::size_t mismatches = 0, runs = 0;
+	auto check = [&](const std::string& what, const std::vector<count_type>& got, const std::vector<count_type>& expected) {
+		runs++;
+		if (got == expected)
+			return;
+		mismatches++;
+		std::cout << "MISMATCH count, " << what << ":";
+		for (auto c: got)
+			std::cout << " " << cfg_string_gen::count_to_string(c);
+		std::cout << ", expected";
+		for (auto c: expected)
+			std::cout << " " << cfg_string_gen::count_to_string(c);
+		std::cout << std::endl;
+	};
+	for (auto& grammar: catalog()) {
+		for (std::size_t depth = 0; depth <= grammar.max_depth; depth++) {
+			auto count = cfg_string_gen::cfg_string_count(grammar.rules, depth);
+			std::vector<count_type> by_length(1, 0), by_depth(depth + 1, 0);
+			for (auto& s: cfg_string_gen::cfg_string_generator<false, true, false, true>(grammar.rules, depth)) {
+				if (s.size() >= by_length.size())
+					by_length.resize(s.size() + 1, 0);
+				by_length[s.size()]++;
+			}
+			count_type derivations = 0;
+			for (auto& s: cfg_string_gen::cfg_string_generator<true, true, false, true>(grammar.rules, depth)) {
+				for (auto& derivation: s.second) {
+					by_depth[derivation.size()]++;
+					derivations++;
+				}
+			}
+			std::string what = std::string(grammar.name) + " at depth " + std::to_string(depth);
+			check(what + ", by length", count.by_length, by_length);
+			check(what + ", by depth", count.by_depth, by_depth);
+			check(what + ", total", {count.total}, {derivations});
+		}
+	}
+	// main.cpp's grammar and depth
+	check("balanced at depth 17, total", {cfg_string_gen::cfg_string_count(catalog().front().rules, 17).total}, {144368});
+	std::cout << "count: " << runs << " runs, " << mismatches << " mismatches" << std::endl;
+	return mismatches;
+}
+
+// the external memory mode with its runs limited to a few bytes, so a worker's spill fails.
+// Returns false if the error didn't reach the caller (or the process ends first)
+bool spill_failure()
+{
+#ifdef __unix__
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_FSIZE, &limit) != 0)
+		return true;
+	struct rlimit small = limit;
+	small.rlim_cur = 1 << 10;
+	// a write past the limit fails instead of sending SIGXFSZ
+	auto previous = std::signal(SIGXFSZ, SIG_IGN);
+	setrlimit(RLIMIT_FSIZE, &small);
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = 2;
+	options.external.budget = 1 << 14;
+	bool thrown = false;
+	try {
+		cfg_string_gen::cfg_string_generator<false, false, false, true>(catalog().front().rules, 14, options);
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	setrlimit(RLIMIT_FSIZE, &limit);
+	std::signal(SIGXFSZ, previous);
+	std::cout << "spill failure: " << (thrown ? "thrown to the caller" : "NOT THROWN") << std::endl;
+	return thrown;
+#else
+	return true;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::size_t> thread_counts = {1, 2, 5};
+	if (argc > 2 && std::string(argv[1]) == "--threads") {
+		thread_counts.clear();
+		std::istringstream counts(argv[2]);
+		for (std::string count; std::getline(counts, count, ',');)
+			thread_counts.push_back(std::strtoul(count.c_str(), nullptr, 10));
+	}
+	std::size_t mismatches = verify<false, false>(thread_counts) + verify<false, true>(thread_counts)
+							+ verify<true, false>(thread_counts) + verify<true, true>(thread_counts) + counts();
+	bool thrown = spill_failure();
+	return mismatches != 0 || !thrown;
+}
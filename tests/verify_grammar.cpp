@@ -0,0 +1,139 @@
+// checks the grammar compilation: NamedGrammar::compile (the chars given to the names, the compiled rules, the
+// strings they generate and its errors), NamedGrammar::render and the tables of detail::CompiledRules.
+// usage: verify_grammar, prints the failures and exits with 1 if there's any
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../cfg_grammar.hpp"
+
+using Rules = std::unordered_map<char, std::vector<std::string>>;
+using Grammar = cfg_string_gen::NamedGrammar<>;
+
+std::size_t failures = 0;
+
+void check(const std::string& what, bool ok)
+{
+	if (ok)
+		return;
+	failures++;
+	std::cout << "FAILED " << what << std::endl;
+}
+
+// arithmetic expressions, with names longer than a char
+Grammar expressions()
+{
+	Grammar grammar("expr");
+	grammar.add_rule("expr", {"term"});
+	grammar.add_rule("expr", {"expr", "+", "term"});
+	grammar.add_rule("term", {"factor"});
+	grammar.add_rule("term", {"term", "*", "factor"});
+	grammar.add_rule("factor", {"(", "expr", ")"});
+	grammar.add_rule("factor", {"x"});
+	return grammar;
+}
+
+void compile()
+{
+	Grammar grammar = expressions();
+	Rules rules = grammar.compile();
+	// the start symbol gets 'S', the others the free capitals in the names' order
+	check("start symbol code", grammar.code("expr") == 'S');
+	check("nonterminal codes", grammar.code("factor") == 'A' && grammar.code("term") == 'B');
+	check("compiled rules", rules == Rules{{'S', {"B", "S+B"}}, {'B', {"A", "B*A"}}, {'A', {"(S)", "x"}}});
+
+	// the strings within 7 derivation steps
+	auto strings = cfg_string_gen::cfg_string_generator<false, false, false, true>(rules, 7);
+	check("generated strings", std::unordered_set<std::string>(strings.begin(), strings.end())
+								== std::unordered_set<std::string>{"x", "x+x", "x*x", "(x)", "x*x*x"});
+}
+
+void render()
+{
+	Grammar grammar = expressions();
+	Rules rules = grammar.compile();
+	check("render form", grammar.render("S+B*x") == "<expr>+<term>*x");
+	check("render terminals", grammar.render("(x)") == "(x)");
+	// the derivations point to the compiled substitutions
+	auto derivations = cfg_string_gen::cfg_string_generator<true, false>(rules, 3);
+	auto done = std::find_if(derivations.begin(), derivations.end(), [](auto& s) { return s.first == "x"; });
+	check("derivation of x", done != derivations.end() && done->second.size() == 1);
+	if (done == derivations.end() || done->second.size() != 1)
+		return;
+	std::vector<std::string> steps;
+	for (auto& step: done->second.front())
+		steps.push_back(grammar.render(*step.second));
+	check("render derivation", steps == std::vector<std::string>{"<term>", "<factor>", "x"});
+}
+
+template <typename Exception>
+void expect_throw(const std::string& what, Grammar grammar)
+{
+	try {
+		grammar.compile();
+	}
+	catch (const Exception&) {
+		return;
+	}
+	catch (...) {
+	}
+	check(what + " throws", false);
+}
+
+void errors()
+{
+	Grammar no_start("start");
+	no_start.add_rule("other", {"x"});
+	expect_throw<std::invalid_argument>("start symbol without rules", no_start);
+
+	Grammar reserved("start");
+	reserved.add_rule("start", {"S", "x"});
+	expect_throw<std::invalid_argument>("'S' on a terminal", reserved);
+
+	// a char for each nonterminal, there's 254 besides '\0' and 'S'
+	Grammar many("start");
+	for (int i = 0; i < 255; i++)
+		many.add_rule("start", {"n" + std::to_string(i)});
+	for (int i = 0; i < 255; i++)
+		many.add_rule("n" + std::to_string(i), {});
+	expect_throw<std::length_error>("more nonterminals than chars", many);
+}
+
+void compiled_rules()
+{
+	Rules rules = {{'S', {"0A", "1B"}}, {'A', {"0AA", "1S", "1"}}, {'B', {"1BB", "0S", "0"}}};
+	cfg_string_gen::detail::CompiledRules<cfg_string_gen::TypeDefs<false>> compiled(rules);
+	check("nonterminals", compiled.size() == 3);
+	std::vector<bool> ids(compiled.size());
+	for (auto& rule: rules) {
+		std::size_t id = compiled.id_of(rule.first);
+		check(std::string("dense id of ") + rule.first, id < ids.size() && !ids[id]);
+		if (id < ids.size())
+			ids[id] = true;
+		auto substitutions = compiled.at(rule.first);
+		check(std::string("rules of ") + rule.first, substitutions.size() == rule.second.size());
+		for (std::size_t i = 0; i < substitutions.size() && i < rule.second.size(); i++) {
+			check(std::string("substitution of ") + rule.first, substitutions[i].str == rule.second[i] && substitutions[i].alternative == i);
+			check(std::string("source of ") + rule.first, &compiled.source_of(substitutions[i]) == &rule.second[i]);
+		}
+	}
+	check("terminals", !compiled.is_nonterminal('0') && !compiled.is_nonterminal('1') && compiled.id_of('0') == compiled.terminal);
+	// A becomes "1" in a step, S needs two
+	check("costs", compiled.cost_of('A').steps == 1 && compiled.cost_of('S').steps == 2 && compiled.cost_of('S').length == 2);
+	check("substitution cost", compiled.cost_of(compiled.at('A')[0]).steps == 2 && compiled.cost_of(compiled.at('A')[2]).steps == 0);
+}
+
+int main()
+{
+	compile();
+	render();
+	errors();
+	compiled_rules();
+	std::cout << "grammar: " << failures << " failures" << std::endl;
+	return failures != 0;
+}
@@ -0,0 +1,150 @@
+// checks the binary output: strings and derivations written by BinaryWriter, on small blocks and from a few
+// threads, must be read back by BinaryOutput as they were generated, in order and by block, with their grammar.
+// The file cut short anywhere must be rejected when it's opened.
+// usage: verify_output, prints the failures and exits with 1 if there's any
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../cfg_string_generator.hpp"
+#include "../output_writer.hpp"
+
+using Rules = std::unordered_map<char, std::vector<std::string>>;
+// a string and the steps of its derivations, as (position, substitution)
+using Steps = std::vector<std::pair<std::size_t, std::string>>;
+using Records = std::multimap<std::string, Steps>;
+
+std::size_t failures = 0;
+
+void check(const std::string& what, bool ok)
+{
+	if (ok)
+		return;
+	failures++;
+	std::cout << "FAILED " << what << std::endl;
+}
+
+// main.cpp's, ambiguous
+const Rules rules = {{'S', {"0A", "1B"}}, {'A', {"0AA", "1S", "1"}}, {'B', {"1BB", "0S", "0"}}};
+// a few records per block
+const std::size_t block_size = 256;
+
+template <typename Derivation>
+Steps steps_of(const Derivation& derivation)
+{
+	Steps steps;
+	for (auto& step: derivation)
+		steps.push_back({step.first, *step.second});
+	return steps;
+}
+
+// the records of a file, the derivations decoded with the file's grammar
+Records read(const cfg_string_gen::BinaryOutput& output, cfg_string_gen::BinaryOutput::Range records)
+{
+	Records read;
+	for (auto record: records) {
+		auto derivations = record.derivations();
+		if (derivations.empty())
+			read.insert({std::string(record.string()), {}});
+		for (auto& derivation: derivations)
+			read.insert({std::string(record.string()), steps_of(cfg_string_gen::decode_derivation(output.rules(), derivation.steps()))});
+	}
+	return read;
+}
+
+// the file written, read whole and block by block
+void round_trip(const std::string& what, const std::filesystem::path& file, const Records& expected, std::size_t records, bool derivations)
+{
+	cfg_string_gen::BinaryOutput output(file);
+	check(what + ", grammar", output.rules() == rules);
+	check(what + ", derivations flag", output.has_derivations() == derivations);
+	check(what + ", records", output.size() == records && static_cast<std::size_t>(std::distance(output.begin(), output.end())) == records);
+	check(what + ", read in order", read(output, output.records()) == expected);
+	Records blocks;
+	std::uint64_t block_records = 0;
+	for (std::size_t i = 0; i < output.num_of_blocks(); i++) {
+		blocks.merge(read(output, output.block(i)));
+		block_records += output.block(i).size();
+	}
+	check(what + ", more than a block", output.num_of_blocks() > 1);
+	check(what + ", read by block", blocks == expected && block_records == records);
+}
+
+void strings(const std::filesystem::path& file)
+{
+	cfg_string_gen::GenerationOptions options;
+	options.num_of_threads = 3;
+	{
+		cfg_string_gen::BinaryWriter<Rules> writer(rules, file, block_size);
+		cfg_string_gen::cfg_string_generator<false, false, false, true>(rules, 10, writer, options);
+		writer.close();
+	}
+	Records expected;
+	for (auto& s: cfg_string_gen::cfg_string_generator<false, false, false, true>(rules, 10))
+		expected.insert({s, {}});
+	round_trip("strings", file, expected, expected.size(), false);
+}
+
+void derivations(const std::filesystem::path& file)
+{
+	auto generated = cfg_string_gen::cfg_string_generator<true, true, false, true>(rules, 8);
+	Records expected;
+	for (auto& s: generated) {
+		for (auto& derivation: s.second)
+			expected.insert({s.first, steps_of(derivation)});
+	}
+	{
+		cfg_string_gen::BinaryWriter<Rules> writer(rules, file, block_size);
+		writer.add_all(generated);
+		writer.close();
+	}
+	round_trip("derivations", file, expected, generated.size(), true);
+}
+
+// the file cut at a few sizes, down to its header
+void truncated(const std::filesystem::path& file, const std::filesystem::path& cut)
+{
+	std::string bytes;
+	{
+		std::ifstream in(file, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	for (std::size_t size: {bytes.size() - 1, bytes.size() - sizeof(cfg_string_gen::BinaryTrailer), bytes.size() / 2,
+							static_cast<std::size_t>(cfg_string_gen::BinaryFormat::header_size), std::size_t(0)}) {
+		{
+			std::ofstream out(cut, std::ios::binary | std::ios::trunc);
+			out.write(bytes.data(), static_cast<std::streamsize>(size));
+		}
+		bool rejected = false;
+		try {
+			cfg_string_gen::BinaryOutput output(cut);
+		}
+		catch (const std::runtime_error&) {
+			rejected = true;
+		}
+		check("truncated to " + std::to_string(size) + " of " + std::to_string(bytes.size()) + " bytes is rejected", rejected);
+	}
+}
+
+int main()
+{
+	auto directory = std::filesystem::temp_directory_path();
+	auto file = directory / "verify_output.bin";
+	auto cut = directory / "verify_output_cut.bin";
+	strings(file);
+	derivations(file);
+	truncated(file, cut);
+	std::filesystem::remove(file);
+	std::filesystem::remove(cut);
+	std::cout << "output: " << failures << " failures" << std::endl;
+	return failures != 0;
+}
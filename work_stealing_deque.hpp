@@ -0,0 +1,124 @@
+#ifndef CFG_STRING_GEN_WORK_STEALING_DEQUE_H
+#define CFG_STRING_GEN_WORK_STEALING_DEQUE_H
+
+/* Chase-Lev work stealing deque, with the memory orderings from
+"Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al., 2013)
+
+the owner thread pushes and pops from the bottom, any other thread
+can steal from the top. Items are pointers, the deque doesn't own them
+*/
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(std::size_t iCapacity = 1024) :
+      mTop(0),
+      mBottom(0) {
+        std::size_t lCapacity = 1;
+        while (lCapacity < iCapacity)
+            lCapacity <<= 1;
+        mArrays.emplace_back(new Array(lCapacity));
+        mArray.store(mArrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // owner only
+    void push(T* iItem) {
+        std::int64_t lBottom = mBottom.load(std::memory_order_relaxed);
+        std::int64_t lTop = mTop.load(std::memory_order_acquire);
+        Array* lArray = mArray.load(std::memory_order_relaxed);
+        if (lBottom - lTop > static_cast<std::int64_t>(lArray->mCapacity) - 1)
+            lArray = grow(lArray, lTop, lBottom);
+        lArray->put(lBottom, iItem);
+        std::atomic_thread_fence(std::memory_order_release);
+        mBottom.store(lBottom + 1, std::memory_order_relaxed);
+    }
+
+    // owner only, returns nullptr if empty
+    T* pop() {
+        std::int64_t lBottom = mBottom.load(std::memory_order_relaxed) - 1;
+        Array* lArray = mArray.load(std::memory_order_relaxed);
+        mBottom.store(lBottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t lTop = mTop.load(std::memory_order_relaxed);
+        T* lItem = nullptr;
+        if (lTop <= lBottom) {
+            lItem = lArray->get(lBottom);
+            if (lTop == lBottom) {
+                // last item, race against the thieves
+                if (!mTop.compare_exchange_strong(lTop, lTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    lItem = nullptr;
+                mBottom.store(lBottom + 1, std::memory_order_relaxed);
+            }
+        }
+        else {
+            mBottom.store(lBottom + 1, std::memory_order_relaxed);
+        }
+        return lItem;
+    }
+
+    // any thread, returns nullptr if empty or if another thread won the race
+    T* steal() {
+        std::int64_t lTop = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t lBottom = mBottom.load(std::memory_order_acquire);
+        if (lTop >= lBottom)
+            return nullptr;
+        Array* lArray = mArray.load(std::memory_order_acquire);
+        T* lItem = lArray->get(lTop);
+        if (!mTop.compare_exchange_strong(lTop, lTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return lItem;
+    }
+
+    // approximation when called concurrently
+    bool empty() const {
+        return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array {
+        explicit Array(std::size_t iCapacity) :
+          mCapacity(iCapacity),
+          mMask(iCapacity - 1),
+          mItems(new std::atomic<T*>[iCapacity]) {
+        }
+
+        T* get(std::int64_t iIndex) const {
+            return mItems[static_cast<std::size_t>(iIndex) & mMask].load(std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t iIndex, T* iItem) {
+            mItems[static_cast<std::size_t>(iIndex) & mMask].store(iItem, std::memory_order_relaxed);
+        }
+
+        std::size_t mCapacity;
+        std::size_t mMask;
+        std::unique_ptr<std::atomic<T*>[]> mItems;
+    };
+
+    // thieves may still be reading the old array, so it's only freed with the deque
+    Array* grow(Array* iArray, std::int64_t iTop, std::int64_t iBottom) {
+        mArrays.emplace_back(new Array(iArray->mCapacity * 2));
+        Array* lArray = mArrays.back().get();
+        for (std::int64_t i = iTop; i < iBottom; i++)
+            lArray->put(i, iArray->get(i));
+        mArray.store(lArray, std::memory_order_release);
+        return lArray;
+    }
+
+    alignas(64) std::atomic<std::int64_t> mTop;
+    alignas(64) std::atomic<std::int64_t> mBottom;
+    alignas(64) std::atomic<Array*> mArray;
+    std::vector<std::unique_ptr<Array>> mArrays;
+};
+
+#endif // CFG_STRING_GEN_WORK_STEALING_DEQUE_H
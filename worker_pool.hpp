@@ -0,0 +1,135 @@
+#ifndef CFG_STRING_GEN_WORKER_POOL_H
+#define CFG_STRING_GEN_WORKER_POOL_H
+
+/* persistent pool of threads, so generations don't spawn and join threads
+on every call.
+
+The algorithms' workers block on barriers and queues, so every task given
+to run() gets its own thread, the pool grows if there isn't enough idle ones.
+A pool runs one generation at a time, use one pool per concurrent generation.
+
+The first exception a task throws is kept and rethrown by wait(), instead of
+ending the process. The other tasks still have to return on their own
+*/
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <deque>
+#include <exception>
+#include <vector>
+#include <cstddef>
+
+class WorkerPool {
+public:
+    explicit WorkerPool(std::size_t iSize = 0) :
+      mIdle(0),
+      mQueued(0),
+      mPending(0),
+      mStop(false) {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        while (mThreads.size() < iSize)
+            spawn();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            mStop = true;
+        }
+        mTaskCond.notify_all();
+        for (auto& lThread: mThreads)
+            lThread.join();
+    }
+
+    // pool used when none is given to the generator
+    static WorkerPool& shared() {
+        static WorkerPool sPool;
+        return sPool;
+    }
+
+    std::size_t size() {
+        std::lock_guard<std::mutex> lLock{mMutex};
+        return mThreads.size();
+    }
+
+    // runs iTask(i) for every i in [0, iCount), each one on its own thread.
+    // Doesn't wait for the tasks to finish, use wait() for that
+    template <typename Task>
+    void run(std::size_t iCount, Task iTask) {
+        {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            for (std::size_t i = 0; i < iCount; i++)
+                mTasks.emplace_back([iTask, i] { iTask(i); });
+            mQueued += iCount;
+            mPending += iCount;
+            while (mIdle < mQueued)
+                spawn();
+        }
+        mTaskCond.notify_all();
+    }
+
+    // blocks until all tasks given to run() returned, then rethrows the first
+    // exception one of them threw, if any
+    void wait() {
+        std::unique_lock<std::mutex> lLock{mMutex};
+        mDoneCond.wait(lLock, [this] { return mPending == 0; });
+        if (mError) {
+            std::exception_ptr lError = nullptr;
+            std::swap(lError, mError);
+            std::rethrow_exception(lError);
+        }
+    }
+
+private:
+    // mMutex must be held
+    void spawn() {
+        mIdle++;
+        mThreads.emplace_back(&WorkerPool::loop, this);
+    }
+
+    void loop() {
+        std::unique_lock<std::mutex> lLock{mMutex};
+        while (true) {
+            mTaskCond.wait(lLock, [this] { return mStop || !mTasks.empty(); });
+            if (mTasks.empty())
+                return;
+            auto lTask = std::move(mTasks.front());
+            mTasks.pop_front();
+            mQueued--;
+            mIdle--;
+            lLock.unlock();
+            std::exception_ptr lError = nullptr;
+            try {
+                lTask();
+            }
+            catch (...) {
+                lError = std::current_exception();
+            }
+            lLock.lock();
+            if (lError && !mError)
+                mError = lError;
+            mIdle++;
+            if (--mPending == 0)
+                mDoneCond.notify_all();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mTaskCond;
+    std::condition_variable mDoneCond;
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mTasks;
+    std::size_t mIdle;
+    std::size_t mQueued;
+    std::size_t mPending;
+    bool mStop;
+    // the first exception thrown by a task since the last wait()
+    std::exception_ptr mError;
+};
+
+#endif // CFG_STRING_GEN_WORKER_POOL_H
@@ -0,0 +1,233 @@
+#ifndef CFG_STRING_GEN_YIELD_CACHE_H
+#define CFG_STRING_GEN_YIELD_CACHE_H
+
+#include "sentential_form.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cfg_string_gen
+{
+	namespace detail {
+		// terminal strings packed in one buffer, so an entry of many short strings is two allocations
+		class Yields {
+		public:
+			std::size_t size() const { return ends.size(); }
+			std::string_view operator[](std::size_t i) const
+			{
+				std::size_t begin = i == 0 ? 0 : ends[i - 1];
+				return {chars.data() + begin, ends[i] - begin};
+			}
+			std::size_t bytes() const { return chars.size() + ends.size() * sizeof(std::size_t); }
+
+			void add(std::string_view str)
+			{
+				chars.append(str.data(), str.size());
+				ends.push_back(chars.size());
+			}
+			// keeps each string once, returns how many were dropped
+			std::size_t dedup()
+			{
+				std::vector<std::string_view> strings;
+				strings.reserve(size());
+				for (std::size_t i = 0; i < size(); i++) {
+					strings.push_back((*this)[i]);
+				}
+				std::sort(strings.begin(), strings.end());
+				strings.erase(std::unique(strings.begin(), strings.end()), strings.end());
+				Yields unique;
+				unique.ends.reserve(strings.size());
+				for (auto str: strings) {
+					unique.add(str);
+				}
+				std::size_t dropped = size() - unique.size();
+				*this = std::move(unique);
+				return dropped;
+			}
+
+		private:
+			std::string chars;
+			std::vector<std::size_t> ends;
+		};
+
+		// the yields of each (nonterminal, steps): the terminal strings of its derivation trees that take exactly steps
+		// derivations (one per tree, or each string once with dedup) and fit on the length bound. An entry is built by
+		// concatenating, for each substitution, the entries of its nonterminals that take steps - 1 derivations together,
+		// so a nonterminal is expanded once per step count instead of once per form it's on. The yields within a budget
+		// of steps are the entries of each count up to it.
+		// The entries take up to budget bytes, the least recently used are dropped and built again if they're needed.
+		// An entry bigger than budget is kept alone, until another one is cached, since building it again takes its
+		// whole subtree; the entries built again are counted (see rebuilds).
+		// Thread safe, an entry asked by two threads before it's cached is built by both
+		template <typename Symbols, typename size_type, bool dedup>
+		class YieldCache {
+		public:
+			using Entry = std::shared_ptr<const Yields>;
+
+			YieldCache(const Symbols& symbols, std::size_t budget) :
+				symbols(symbols),
+				max_length(symbols.length_bound().length),
+				budget(budget) {}
+
+			Entry get(char nonterminal, size_type steps)
+			{
+				std::uint64_t key = (static_cast<std::uint64_t>(steps) << 8) | static_cast<unsigned char>(nonterminal);
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					auto it = entries.find(key);
+					if (it != entries.end()) {
+						lru.splice(lru.begin(), lru, it->second.position);
+						return it->second.yields;
+					}
+				}
+				std::size_t duplicates = 0;
+				Entry yields = build(nonterminal, steps, duplicates);
+				put(key, yields, duplicates);
+				return yields;
+			}
+
+			// the entries built more than once, after being dropped or by two threads at once
+			std::size_t rebuilds()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return rebuilt;
+			}
+			// the yields dropped by dedup, on each entry's first build
+			std::size_t duplicates()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				return dropped;
+			}
+
+			// calls emit with prefix followed by each string form yields within steps derivations
+			// (exactly steps, if exactly). prefix is used as the buffer, and left as it was.
+			// The entries used are kept until it returns, even if they're dropped from the cache
+			template <typename Emit>
+			void expand(std::string_view form, size_type steps, bool exactly, std::string& prefix, Emit& emit)
+			{
+				Expansion expansion{form, steps + 1, std::vector<Cost<size_type>>(form.size() + 1),
+									std::vector<Entry>(form.size() * (steps + 1))};
+				auto& rest = expansion.rest;
+				// what the symbols from each position on need
+				for (std::size_t i = form.size(); i-- > 0;) {
+					rest[i] = symbols.cost_of(form[i]);
+					rest[i] += rest[i + 1];
+				}
+				if (rest[0].steps > steps || prefix.size() + rest[0].length > max_length)
+					return;
+				concat(expansion, 0, steps, exactly, prefix, emit);
+			}
+
+		private:
+			struct Slot {
+				Entry yields;
+				std::list<std::uint64_t>::iterator position;
+			};
+
+			struct Expansion {
+				std::string_view form;
+				size_type budgets;
+				// what the symbols from each position on need
+				std::vector<Cost<size_type>> rest;
+				// the entry of the nonterminal at each position with each step count, once it's used
+				std::vector<Entry> entries;
+			};
+
+			template <typename Emit>
+			void concat(Expansion& expansion, std::size_t i, size_type steps, bool exactly, std::string& prefix, Emit& emit)
+			{
+				std::string_view form = expansion.form;
+				const auto& rest = expansion.rest;
+				std::size_t start = prefix.size();
+				// the terminals up to the next nonterminal
+				for (; i < form.size() && !symbols.is_nonterminal(form[i]); i++) {
+					prefix.push_back(form[i]);
+				}
+				if (i == form.size()) {
+					if (!exactly || steps == 0)
+						emit(prefix);
+				}
+				else {
+					char nonterminal = form[i];
+					size_type others = rest[i + 1].steps;
+					// the last nonterminal takes all the steps left, if exactly
+					size_type first = exactly && others == 0 ? steps : symbols.cost_of(nonterminal).steps;
+					for (size_type n = first; n + others <= steps; n++) {
+						Entry& yields = expansion.entries[i * expansion.budgets + n];
+						if (!yields)
+							yields = get(nonterminal, n);
+						for (std::size_t y = 0; y < yields->size(); y++) {
+							std::string_view str = (*yields)[y];
+							if (prefix.size() + str.size() + rest[i + 1].length > max_length)
+								continue;
+							std::size_t length = prefix.size();
+							prefix.append(str.data(), str.size());
+							concat(expansion, i + 1, steps - n, exactly, prefix, emit);
+							prefix.resize(length);
+						}
+					}
+				}
+				prefix.resize(start);
+			}
+
+			Entry build(char nonterminal, size_type steps, std::size_t& duplicates)
+			{
+				auto yields = std::make_shared<Yields>();
+				if (steps >= symbols.cost_of(nonterminal).steps) {
+					std::string buffer;
+					auto add = [&yields](const std::string& str) { yields->add(str); };
+					for (auto& substitution: symbols.at(nonterminal)) {
+						expand(substitution.str, steps - 1, true, buffer, add);
+					}
+					if constexpr(dedup)
+						duplicates = yields->dedup();
+				}
+				return yields;
+			}
+
+			void put(std::uint64_t key, const Entry& yields, std::size_t duplicates)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (built.insert(key).second)
+					dropped += duplicates;
+				else
+					rebuilt++;
+				if (entries.count(key) != 0)
+					return;
+				// one bigger than budget drops all the others
+				while (!lru.empty() && bytes + yields->bytes() > budget) {
+					auto last = entries.find(lru.back());
+					bytes -= last->second.yields->bytes();
+					entries.erase(last);
+					lru.pop_back();
+				}
+				lru.push_front(key);
+				entries.emplace(key, Slot{yields, lru.begin()});
+				bytes += yields->bytes();
+			}
+
+			const Symbols& symbols;
+			std::size_t max_length;
+			std::size_t budget;
+			std::mutex mutex;
+			std::unordered_map<std::uint64_t, Slot> entries;
+			// the keys, the most recently used first
+			std::list<std::uint64_t> lru;
+			std::size_t bytes = 0;
+			// the keys of the entries built so far
+			std::unordered_set<std::uint64_t> built;
+			std::size_t rebuilt = 0;
+			std::size_t dropped = 0;
+		};
+	}
+}
+#endif // CFG_STRING_GEN_YIELD_CACHE_H